@@ -0,0 +1,100 @@
+#!/bin/sh
+# Measure compile time and object size of generated test files.
+#
+# usage: bench/compile.sh [--save FILE] [--compare FILE] [N...]
+#
+# For each N a file with N assertions split into tests of 100 assertions
+# is generated and compiled to an object file. The runtime is compiled
+# separately from ctest.c so only the cost of macro expansions is measured.
+# Environment variables CC and CFLAGS select the compiler and its flags.
+#
+# --save writes the results to FILE. --compare prints the change from
+# results saved in FILE and fails if time or size of any row grew by more
+# than THRESHOLD percent, 10 by default.
+
+set -e
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O0}
+THRESHOLD=${THRESHOLD:-10}
+SAVE=
+COMPARE=
+while [ $# -gt 0 ]; do
+    case $1 in
+    --save) SAVE=$2; shift 2 ;;
+    --compare) COMPARE=$2; shift 2 ;;
+    *) break ;;
+    esac
+done
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+gen() {
+    n=$1
+    echo '#include "ctest.h"'
+    echo 'typedef struct { int x; } Fixture;'
+    echo 'TEST_F_INIT(Fixture) { self->x = 1; }'
+    i=0
+    while [ $i -lt $n ]; do
+        if [ $((i % 100)) -eq 0 ]; then
+            [ $i -gt 0 ] && echo '}'
+            if [ $((i % 200)) -eq 0 ]; then
+                echo "TEST(Suite, Test$i) { int x = 1;"
+            else
+                echo "TEST_F(Fixture, Test$i) { int x = self->x;"
+            fi
+        fi
+        case $((i % 4)) in
+        0) echo "    EXPECT_EQ(x, $i - $i + 1);" ;;
+        1) echo "    ASSERT_EQ(x + $i, 1 + $i);" ;;
+        2) echo "    EXPECT_TRUE(x == 1);" ;;
+        3) echo "    ASSERT_LT(x, $i + 2);" ;;
+        esac
+        i=$((i + 1))
+    done
+    [ $n -gt 0 ] && echo '}'
+}
+
+now() {
+    date +%s.%N
+}
+
+# row NAME OBJECT T0 T1 prints and records one result
+row() {
+    printf "%s %.3f %d\n" "$1" "$(awk "BEGIN { print $4 - $3 }")" \
+        "$(wc -c < "$2")" >> "$TMP/results"
+    tail -n 1 "$TMP/results" | awk '{ printf "%-12s %10.3f %12d\n", $1, $2, $3 }'
+}
+
+printf "%-12s %10s %12s\n" "assertions" "time [s]" "object [B]"
+t0=$(now)
+$CC $CFLAGS -I"$ROOT" -c "$ROOT/ctest.c" -o "$TMP/ctest.o"
+t1=$(now)
+row runtime "$TMP/ctest.o" "$t0" "$t1"
+
+for n in ${@:-1000 10000}; do
+    gen "$n" > "$TMP/gen_$n.c"
+    t0=$(now)
+    $CC $CFLAGS -w -I"$ROOT" -c "$TMP/gen_$n.c" -o "$TMP/gen_$n.o"
+    t1=$(now)
+    row "$n" "$TMP/gen_$n.o" "$t0" "$t1"
+done
+
+[ -n "$SAVE" ] && cp "$TMP/results" "$SAVE"
+
+if [ -n "$COMPARE" ]; then
+    echo
+    printf "%-12s %10s %12s\n" "change" "time [%]" "object [%]"
+    awk -v limit="$THRESHOLD" '
+        function pct(new, old) { return old > 0 ? 100 * (new - old) / old : 0 }
+        NR == FNR { time[$1] = $2; size[$1] = $3; next }
+        $1 in time {
+            dt = pct($2, time[$1]); ds = pct($3, size[$1])
+            flag = dt > limit || ds > limit ? "  regression" : ""
+            printf "%-12s %+10.1f %+12.1f%s\n", $1, dt, ds, flag
+            if (flag) failed = 1
+        }
+        END { exit failed }
+    ' "$COMPARE" "$TMP/results"
+fi
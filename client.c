@@ -0,0 +1,12 @@
+/*
+ * Client of a resident test server. It links no tests, so a rerun does
+ * not pay the startup cost of the test binary.
+ *
+ *   cc -o client client.c
+ *   ./tests --ctest_serve=/tmp/tests.sock &
+ *   ./client --ctest_connect=/tmp/tests.sock --ctest_filter=Suite.*
+ */
+#define CTEST_IMPLEMENTATION
+#include "ctest.h"
+
+CTEST_MAIN()
@@ -0,0 +1,65 @@
+/*
+ * Tests of time-dependent code running on the virtual clock.
+ *
+ *   cc -o clock clock.c
+ *   ./clock
+ *
+ * All sleeps below take no real time.
+ */
+#define CTEST_FAKE_CLOCK
+#define CTEST_IMPLEMENTATION
+#include "ctest.h"
+
+#include <time.h>
+#include <unistd.h>
+
+static long long now_ns(clockid_t id) {
+	struct timespec ts;
+	clock_gettime(id, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* earliest start of a test, virtual time of a later test starts close to it */
+static long long first_start_ns;
+
+static void check_reset(void) {
+	long long start = now_ns(CLOCK_REALTIME);
+	if (!first_start_ns || start < first_start_ns)
+		first_start_ns = start;
+	EXPECT_LT(start - first_start_ns, 60 * 1000000000LL);
+}
+
+TEST(Clock, Sleep) {
+	check_reset();
+	long long t0 = now_ns(CLOCK_MONOTONIC);
+	time_t s0 = time(NULL);
+	sleep(60);
+	usleep(500000);
+	struct timespec ts = { 1, 500000000L };
+	ASSERT_EQ(nanosleep(&ts, NULL), 0);
+	EXPECT_EQ(now_ns(CLOCK_MONOTONIC) - t0, 62 * 1000000000LL);
+	EXPECT_GE(time(NULL) - s0, 61);
+}
+
+TEST(Clock, Advance) {
+	check_reset();
+	long long t0 = now_ns(CLOCK_MONOTONIC);
+	EXPECT_EQ(now_ns(CLOCK_MONOTONIC), t0);
+	ctest_clock_advance(3600 * 1000000000LL);
+	EXPECT_EQ(now_ns(CLOCK_MONOTONIC) - t0, 3600 * 1000000000LL);
+	EXPECT_GE(now_ns(CLOCK_REALTIME) - first_start_ns, 3600 * 1000000000LL);
+}
+
+TEST(Clock, AbsoluteDeadline) {
+	check_reset();
+	long long deadline = now_ns(CLOCK_MONOTONIC) + 5 * 1000000000LL;
+	struct timespec ts = { deadline / 1000000000LL, deadline % 1000000000LL };
+	ASSERT_EQ(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL), 0);
+	EXPECT_EQ(now_ns(CLOCK_MONOTONIC), deadline);
+
+	// a deadline in the past returns at once
+	ASSERT_EQ(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL), 0);
+	EXPECT_EQ(now_ns(CLOCK_MONOTONIC), deadline);
+}
+
+CTEST_MAIN()
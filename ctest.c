@@ -0,0 +1,8 @@
+/*
+ * Separately compiled implementation of ctest.
+ *
+ * Link ctest.o with test files that include ctest.h without defining
+ * CTEST_IMPLEMENTATION to avoid compiling the runtime in every binary.
+ */
+#define CTEST_IMPLEMENTATION
+#include "ctest.h"
@@ -25,6 +25,8 @@ SOFTWARE.
 #ifndef CTEST_H
 #define CTEST_H __FILE__
 
+#include <stddef.h>
+
 void ctest_fail_test(void);
 void ctest_drop_test(const char *fpath, int line);
 void ctest_skip_test(void);
@@ -40,11 +42,25 @@ enum ctest_status {
     CTEST_FAILURE,
 };
 
+enum ctest__step {
+    CTEST__INIT,
+    CTEST__EXEC,
+    CTEST__DROP,
+};
+
+struct ctest_data {
+    const char * path;
+    size_t size;
+    void (*exec)(const void *, size_t);
+};
+
 typedef struct ctest {
     const char * name;
     void (*_init)(void);
     void (*_exec)(void);
     void (*_drop)(void);
+    void (*_step)(int); // replaces _init, _exec and _drop if set
+    const struct ctest_data * _cases;
     void  *_data;
     struct ctest * _next;
     enum ctest_status _status;
@@ -52,6 +68,18 @@ typedef struct ctest {
 
 void ctest_register(ctest *);
 
+#ifdef CTEST_FAKE_CLOCK
+/**
+ * @brief Advance virtual time seen by the running test.
+ *
+ * Requires CTEST_FAKE_CLOCK defined for the implementation, which replaces
+ * clock_gettime(), clock_nanosleep(), nanosleep(), usleep(), sleep()
+ * and time() of the program. Virtual time starts at the real time of
+ * the start of each test and moves only with sleeps and this function.
+ */
+void ctest_clock_advance(long long ns);
+#endif
+
 /**
  * @brief Add a test case within a test suite. Parameters must be expanded.
  */
@@ -85,25 +113,19 @@ void ctest_register(ctest *);
     static void (*tfixture ## __init)(tfixture*);   \
     static void (*tfixture ## __drop)(tfixture*);   \
                                                     \
-    static void tfixture ## tcase ## __init(void) { \
-        if (tfixture ## __init)                     \
-            tfixture ## __init(&tfixture ## __data);\
-    }                                               \
     static void tfixture ## tcase(tfixture *);      \
-    static void tfixture ## tcase ## __exec(void) { \
-        tfixture ## tcase(&tfixture ## __data);     \
-    }                                               \
-    static void tfixture ## tcase ## __drop(void) { \
-        if (tfixture ## __drop)                     \
-            tfixture ## __drop(&tfixture ## __data);\
+    static void tfixture ## tcase ## __step(int step) { \
+        void (*f)(tfixture*) =                      \
+            step == CTEST__INIT ? tfixture ## __init : \
+            step == CTEST__EXEC ? tfixture ## tcase : \
+                                  tfixture ## __drop; \
+        if (f) f(&tfixture ## __data);              \
     }                                               \
     __attribute__((constructor))                    \
     static void tfixture ## tcase ## __ctor(void) { \
         static ctest instance = {                   \
             .name = #tfixture "." #tcase,           \
-            ._init = tfixture ## tcase ## __init,   \
-            ._exec = tfixture ## tcase ## __exec,   \
-            ._drop = tfixture ## tcase ## __drop,   \
+            ._step = tfixture ## tcase ## __step,   \
         };                                          \
         ctest_register(&instance);                  \
     }                                               \
@@ -130,23 +152,116 @@ void ctest_register(ctest *);
 #define CTEST_TEST_F(test_fixture, test_case) \
     CTEST__TEST_F(test_fixture, test_case)
 
+/**
+ * @brief Add a test executed for each record of a file. Parameters must be expanded.
+ */
+#define CTEST__TEST_DATA(tsuite, tcase, tpath, ttype) \
+    static void tsuite ## tcase(const ttype *, size_t);   \
+    static void tsuite ## tcase ## __case(const void * rec, size_t idx) { \
+        tsuite ## tcase(rec, idx);                        \
+    }                                                     \
+    __attribute__((constructor))                          \
+    static void tsuite ## tcase ## __ctor(void) {         \
+        static const struct ctest_data cases = {          \
+            .path = tpath,                                \
+            .size = sizeof(ttype),                        \
+            .exec = tsuite ## tcase ## __case,            \
+        };                                                \
+        static ctest instance = {                         \
+            .name = #tsuite "." #tcase,                   \
+            ._cases = &cases,                             \
+        };                                                \
+        ctest_register(&instance);                        \
+    }                                                     \
+    static void tsuite ## tcase(                          \
+        const ttype * self __attribute__((unused)),       \
+        size_t case_index __attribute__((unused)))
+
+/**
+ * @brief Add a test executed for each record of a file. Parameters can be macros.
+ *
+ * The file is memory mapped and records are accessed via `self` without
+ * copying. Each record is a case named `tsuite.tcase/case_index`
+ * that can be selected with a filter.
+ *
+ * @param tsuite a name of the test suite
+ * @param tcase a name of the test case with a suite
+ * @param tpath a path to the file with records
+ * @param ttype a type of a record
+ */
+#define CTEST_TEST_DATA(test_suite, test_case, path, record_type) \
+    CTEST__TEST_DATA(test_suite, test_case, path, record_type)
+
+void ctest__explore(void (*)(void));
+
+/**
+ * @brief Mark a point where a logical thread of TEST_SCHED may be preempted.
+ *
+ * Does nothing outside of TEST_SCHED.
+ */
+void ctest_yield_point(void);
+
+/**
+ * @brief Start a logical thread in TEST_SCHED, a yield point.
+ */
+void ctest_thread(void (*fn)(void *), void * arg);
+
+/**
+ * @brief Wait until all logical threads of TEST_SCHED finish.
+ */
+void ctest_join(void);
+
+/**
+ * @brief Add a concurrency test. Parameters must be expanded.
+ */
+#define CTEST__TEST_SCHED(tsuite, tcase) \
+    static void tsuite ## tcase(void);            \
+    static void tsuite ## tcase ## __exec(void) { \
+        ctest__explore(tsuite ## tcase);          \
+    }                                             \
+    __attribute__((constructor))                  \
+    static void tsuite ## tcase ## __ctor(void) { \
+        static ctest instance = {                 \
+            .name = #tsuite "." #tcase,           \
+            ._exec = tsuite ## tcase ## __exec,   \
+        };                                        \
+        ctest_register(&instance);                \
+    }                                             \
+    static void tsuite ## tcase(void)
+
+/**
+ * @brief Add a concurrency test. Parameters can be macros.
+ *
+ * The body is executed once per explored schedule. Logical threads started
+ * with ctest_thread() run one at a time and switch only at yield points.
+ *
+ * @param tsuite a name of the test suite
+ * @param tcase a name of the test case with a suite
+ */
+#define CTEST_TEST_SCHED(test_suite, test_case) \
+    CTEST__TEST_SCHED(test_suite, test_case)
+
 #define CTEST_FAIL() ctest_drop_test(__FILE__, __LINE__)
 #define CTEST_SKIP() ctest_skip_test()
 
-void ctest__cleanup(const int *);
+void ctest__abort(void) __attribute__((noreturn));
 
+/* the statement following ASSERT is executed before aborting the test */
 #define ASSERT__WRAP(...) \
-    for(int _armed __attribute__((cleanup(ctest__cleanup))) = 0; \
-        !_armed && !(__VA_ARGS__);                               \
-        _armed = 1)
+    if (__VA_ARGS__); else for (;; ctest__abort())
 
 #define EXPECT__WRAP(...) \
     if (__VA_ARGS__); else
 
-#define CTEST_MAIN() \
+#ifdef CTEST_SHARED_RUNTIME
+/* tests are executed by the runner that loaded the module */
+#  define CTEST_MAIN()
+#else
+#  define CTEST_MAIN() \
 int main(int argc, char *argv[]) { \
     return ctest_main(&argc, argv); \
 }
+#endif
 #define CTEST_LOG(...) ctest_log(__VA_ARGS__)
 
 enum ctest__cmp {
@@ -171,6 +286,32 @@ int ctest__cmp_ptr(const char *, int, const volatile void *, const char *,
 int ctest__check_bool(const char *, int, _Bool, const char *, _Bool);
 int ctest__check_near(const char *, int, double, const char *, double, const char *, double);
 
+struct ctest__poll {
+    long long start_ns;
+    long long timeout_ns;
+    long long elapsed_ns;
+    long long sleep_ns;
+    unsigned polls;
+    _Bool last;
+    _Bool done;
+};
+
+struct ctest__poll ctest__poll_start(long long timeout_ms);
+int ctest__poll_step(struct ctest__poll *, _Bool);
+int ctest__check_eventually(const char *, int, const struct ctest__poll *, const char *);
+
+/* the predicate is polled until it holds or timeout expires, then checked once */
+#define CTEST__EVENTUALLY(pred, timeout_ms, WRAP)                        \
+    for (struct ctest__poll ctest__p = ctest__poll_start(timeout_ms);    \
+         !ctest__p.done; )                                               \
+        if (!ctest__poll_step(&ctest__p, (pred))); else                  \
+        WRAP(ctest__check_eventually(__FILE__, __LINE__, &ctest__p, #pred))
+
+#define CTEST_ASSERT_EVENTUALLY(pred, timeout_ms) \
+    CTEST__EVENTUALLY(pred, timeout_ms, ASSERT__WRAP)
+#define CTEST_EXPECT_EVENTUALLY(pred, timeout_ms) \
+    CTEST__EVENTUALLY(pred, timeout_ms, EXPECT__WRAP)
+
 #define CTEST_ASSERT_TRUE(pred) \
     ASSERT__WRAP(ctest__check_bool(__FILE__, __LINE__, (pred), #pred, 1))
 #define CTEST_ASSERT_FALSE(pred) \
@@ -180,17 +321,12 @@ int ctest__check_near(const char *, int, double, const char *, double, const cha
 #define CTEST_EXPECT_FALSE(pred) \
     EXPECT__WRAP(ctest__check_bool(__FILE__, __LINE__, (pred), #pred, 0))
 
+/* types of rank lower than int are promoted by the conditional operator */
 #define CTEST__CMP(a, cmp, b)                 \
 _Generic(1 ? (a) : (b)                        \
-    , _Bool: ctest__cmp_unsigned              \
-    , char: ctest__cmp_signed                 \
-    , signed char: ctest__cmp_signed          \
-    , short: ctest__cmp_signed                \
     , int: ctest__cmp_signed                  \
     , long: ctest__cmp_signed                 \
     , long long: ctest__cmp_signed            \
-    , unsigned char: ctest__cmp_unsigned      \
-    , unsigned short: ctest__cmp_unsigned     \
     , unsigned int: ctest__cmp_unsigned       \
     , unsigned long: ctest__cmp_unsigned      \
     , unsigned long long: ctest__cmp_unsigned \
@@ -268,28 +404,73 @@ _Generic(1 ? (a) : (b)                        \
 #  define EXPECT_STR_EQ   CTEST_EXPECT_STR_EQ
 #  define ASSERT_NEAR     CTEST_ASSERT_NEAR
 #  define EXPECT_NEAR     CTEST_EXPECT_NEAR
+#  define ASSERT_EVENTUALLY CTEST_ASSERT_EVENTUALLY
+#  define EXPECT_EVENTUALLY CTEST_EXPECT_EVENTUALLY
 #  define FAIL            CTEST_FAIL
 #  define SKIP            CTEST_SKIP
 #  define TEST            CTEST_TEST
 #  define TEST_F          CTEST_TEST_F
 #  define TEST_F_INIT     CTEST_TEST_F_INIT
 #  define TEST_F_DROP     CTEST_TEST_F_DROP
+#  define TEST_DATA       CTEST_TEST_DATA
+#  define TEST_SCHED      CTEST_TEST_SCHED
 #  define LOG             CTEST_LOG
 #endif
 
 #endif // CTEST_H
 
 
-#ifdef CTEST_IMPLEMENTATION
+/* modules built with CTEST_SHARED_RUNTIME use the implementation of the runner */
+#if defined(CTEST_IMPLEMENTATION) && !defined(CTEST_SHARED_RUNTIME)
+
+/* POSIX interfaces are hidden in strict ISO C modes, e.g. -std=c11 */
+#if !defined(_DEFAULT_SOURCE) && !defined(_GNU_SOURCE)
+#  define _DEFAULT_SOURCE
+#endif
 
 #include <assert.h>
+#include <errno.h>
+#include <sched.h>
 #include <setjmp.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#  include <sys/syscall.h>
+#endif
+#ifdef __GLIBC__
+#  include <malloc.h>
+#endif
+#if defined(__linux__) && defined(__GLIBC__)
+#  define CTEST_HAVE_EXECINFO 1
+#  define CTEST_HAVE_UCONTEXT 1
+#  include <elf.h>
+#  include <execinfo.h>
+#  include <ucontext.h>
+#endif
+#if defined(CTEST_RUNNER) || defined(CTEST_FAKE_CLOCK)
+#  include <dlfcn.h>
+#endif
+
+/* a libc header included before ctest.h in strict ISO C mode keeps POSIX
+   interfaces hidden, features built on them are left out then */
+#if defined(CLOCK_MONOTONIC) && defined(MAP_ANONYMOUS) && defined(SA_SIGINFO)
+#  define CTEST_HAVE_POSIX 1
+#else
+#  define CTEST_HAVE_POSIX 0
+#endif
 
 #define CTEST__CMP_XMACRO(X) \
     X(EQ, ==) \
@@ -336,6 +517,236 @@ int ctest__check_near(
     return 0;
 }
 
+#if defined(CTEST_FAKE_CLOCK) && !CTEST_HAVE_POSIX
+#  error "CTEST_FAKE_CLOCK needs POSIX clocks, include ctest.h before other headers or define _DEFAULT_SOURCE"
+#elif defined(CTEST_FAKE_CLOCK)
+
+#ifndef RTLD_NEXT
+#  define RTLD_NEXT ((void *) -1l) // hidden without _GNU_SOURCE
+#endif
+
+/* virtual time is active only while a test runs */
+static volatile int ctest_clock_active;
+static long long ctest_clock_offset_ns;
+static struct timespec ctest_clock_base_realtime;
+static struct timespec ctest_clock_base_monotonic;
+
+/* the next definition is found only when libc is linked dynamically */
+static void * ctest_real(const char * name) {
+    void * f = dlsym(RTLD_NEXT, name);
+    if (!f) {
+        fprintf(stderr, "ctest: cannot find %s, CTEST_FAKE_CLOCK requires "
+                "dynamic linking\n", name);
+        abort();
+    }
+    return f;
+}
+
+#define CTEST_REAL(type, name, ...) \
+    static type (*real)(__VA_ARGS__); \
+    if (!real) real = (type (*)(__VA_ARGS__))ctest_real(#name)
+
+static int ctest_real_clock_gettime(clockid_t id, struct timespec * ts) {
+    CTEST_REAL(int, clock_gettime, clockid_t, struct timespec *);
+    return real(id, ts);
+}
+
+static int ctest_real_nanosleep(const struct timespec * req, struct timespec * rem) {
+    CTEST_REAL(int, nanosleep, const struct timespec *, struct timespec *);
+    return real(req, rem);
+}
+
+static void ctest_clock_reset(void) {
+    ctest_real_clock_gettime(CLOCK_REALTIME, &ctest_clock_base_realtime);
+    ctest_real_clock_gettime(CLOCK_MONOTONIC, &ctest_clock_base_monotonic);
+    __atomic_store_n(&ctest_clock_offset_ns, 0, __ATOMIC_RELAXED);
+    ctest_clock_active = 1;
+}
+
+static void ctest_clock_stop(void) {
+    ctest_clock_active = 0;
+}
+
+void ctest_clock_advance(long long ns) {
+    if (ns > 0)
+        __atomic_fetch_add(&ctest_clock_offset_ns, ns, __ATOMIC_RELAXED);
+}
+
+static const struct timespec * ctest_clock_base(clockid_t id) {
+    switch (id) {
+    case CLOCK_REALTIME:
+#ifdef CLOCK_REALTIME_COARSE
+    case CLOCK_REALTIME_COARSE:
+#endif
+        return &ctest_clock_base_realtime;
+    case CLOCK_MONOTONIC:
+#ifdef CLOCK_MONOTONIC_RAW
+    case CLOCK_MONOTONIC_RAW:
+#endif
+#ifdef CLOCK_MONOTONIC_COARSE
+    case CLOCK_MONOTONIC_COARSE:
+#endif
+#ifdef CLOCK_BOOTTIME
+    case CLOCK_BOOTTIME:
+#endif
+        return &ctest_clock_base_monotonic;
+    default:
+        // CPU time clocks are never virtual
+        return 0;
+    }
+}
+
+static long long ctest_clock_virtual_ns(clockid_t id) {
+    const struct timespec * base = ctest_clock_base(id);
+    return base->tv_sec * 1000000000LL + base->tv_nsec +
+           __atomic_load_n(&ctest_clock_offset_ns, __ATOMIC_RELAXED);
+}
+
+int clock_gettime(clockid_t id, struct timespec * ts) {
+    if (!ctest_clock_active || !ctest_clock_base(id))
+        return ctest_real_clock_gettime(id, ts);
+    long long ns = ctest_clock_virtual_ns(id);
+    ts->tv_sec = ns / 1000000000LL;
+    ts->tv_nsec = ns % 1000000000LL;
+    return 0;
+}
+
+time_t time(time_t * t) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    if (t)
+        *t = ts.tv_sec;
+    return ts.tv_sec;
+}
+
+int nanosleep(const struct timespec * req, struct timespec * rem) {
+    if (!ctest_clock_active)
+        return ctest_real_nanosleep(req, rem);
+    if (req->tv_nsec < 0 || req->tv_nsec >= 1000000000L || req->tv_sec < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    ctest_clock_advance(req->tv_sec * 1000000000LL + req->tv_nsec);
+    if (rem)
+        rem->tv_sec = rem->tv_nsec = 0;
+    return 0;
+}
+
+int clock_nanosleep(clockid_t id, int flags, const struct timespec * req,
+                    struct timespec * rem) {
+    if (!ctest_clock_active || !ctest_clock_base(id)) {
+        CTEST_REAL(int, clock_nanosleep, clockid_t, int,
+                   const struct timespec *, struct timespec *);
+        return real(id, flags, req, rem);
+    }
+    long long ns = req->tv_sec * 1000000000LL + req->tv_nsec;
+    if (flags & TIMER_ABSTIME)
+        ns -= ctest_clock_virtual_ns(id);
+    ctest_clock_advance(ns);
+    if (rem && !(flags & TIMER_ABSTIME))
+        rem->tv_sec = rem->tv_nsec = 0;
+    return 0;
+}
+
+int usleep(useconds_t usec) {
+    struct timespec ts = { usec / 1000000, usec % 1000000 * 1000L };
+    return nanosleep(&ts, 0);
+}
+
+unsigned sleep(unsigned sec) {
+    struct timespec ts = { sec, 0 };
+    return nanosleep(&ts, 0) == 0 ? 0 : sec;
+}
+
+#undef CTEST_REAL
+
+#else
+
+#define ctest_real_clock_gettime clock_gettime
+#define ctest_real_nanosleep nanosleep
+
+static void ctest_clock_reset(void) {}
+static void ctest_clock_stop(void) {}
+
+#endif
+
+static long long ctest_now_ns(void) {
+    struct timespec ts;
+#if CTEST_HAVE_POSIX
+    ctest_real_clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void ctest_sleep_ns(long long ns) {
+#if CTEST_HAVE_POSIX
+    struct timespec ts = { ns / 1000000000LL, ns % 1000000000LL };
+    ctest_real_nanosleep(&ts, 0);
+#else
+    // without nanosleep() yield until the deadline
+    for (long long end = ctest_now_ns() + ns; ctest_now_ns() < end; )
+        sched_yield();
+#endif
+}
+
+#define CTEST_POLL_SPINS    64
+#define CTEST_POLL_YIELDS   128
+#define CTEST_POLL_SLEEP_NS 1000LL
+#define CTEST_POLL_MAX_SLEEP_NS 10000000LL
+
+struct ctest__poll ctest__poll_start(long long timeout_ms) {
+    return (struct ctest__poll) {
+        .start_ns = ctest_now_ns(),
+        .timeout_ns = timeout_ms * 1000000LL,
+        .sleep_ns = CTEST_POLL_SLEEP_NS,
+    };
+}
+
+/**
+ * @brief Record a value of the predicate and wait before the next poll.
+ *
+ * Waiting starts with spinning, continues with yielding the CPU and
+ * ends with sleeps of exponentially growing length.
+ *
+ * @return 1 if polling is finished
+ */
+int ctest__poll_step(struct ctest__poll * p, _Bool value) {
+    ++p->polls;
+    p->last = value;
+
+    p->elapsed_ns = ctest_now_ns() - p->start_ns;
+    long long left = p->timeout_ns - p->elapsed_ns;
+    if (value || left <= 0)
+        return p->done = 1;
+
+    // let other logical threads of TEST_SCHED make progress
+    ctest_yield_point();
+    if (p->polls < CTEST_POLL_SPINS) {
+        for (volatile int i = 0; i < 100; ++i)
+            ;
+    } else if (p->polls < CTEST_POLL_YIELDS) {
+        sched_yield();
+    } else {
+        ctest_sleep_ns(p->sleep_ns < left ? p->sleep_ns : left);
+        if (p->sleep_ns < CTEST_POLL_MAX_SLEEP_NS)
+            p->sleep_ns *= 2;
+    }
+    return 0;
+}
+
+int ctest__check_eventually(
+    const char *fpath, int lineno,
+    const struct ctest__poll * p, const char * pred_str
+) {
+    if (ctest__check_bool(fpath, lineno, p->last, pred_str, 1))
+        return 1;
+    fprintf(stdout, "  last value was false after %u polls in %lld ms\n",
+        p->polls, p->elapsed_ns / 1000000LL);
+    return 0;
+}
+
 #define CTEST__CMP_FUNC_IMPL(FNAME, TYPE, FMT, X) \
 int FNAME(                                        \
     const char *fpath, int lineno,                \
@@ -367,9 +778,10 @@ CTEST__CMP_FUNC_IMPL(ctest__cmp_str, const char *, "\"%s\"", X)
 
 static volatile enum ctest_status ctest_status;
 static jmp_buf ctest_longjmp_env;
+static jmp_buf * ctest_jmp = &ctest_longjmp_env; // changes with logical threads
 
-void ctest__cleanup(const int * armed) {
-    if (*armed) longjmp(ctest_longjmp_env, 1);
+void ctest__abort(void) {
+    longjmp(*ctest_jmp, 1);
 }
 
 void ctest_fail_test(void) {
@@ -379,13 +791,13 @@ void ctest_fail_test(void) {
 void ctest_drop_test(const char *fpath, int line) {
     fprintf(stdout, "%s:%d: Failure\n", fpath, line);
     ctest_status = CTEST_FAILURE;
-    longjmp(ctest_longjmp_env, 1);
+    longjmp(*ctest_jmp, 1);
 }
 
 void ctest_skip_test(void) {
     if (ctest_status != CTEST_FAILURE)
         ctest_status = CTEST_SKIPPED;
-    longjmp(ctest_longjmp_env, 1);
+    longjmp(*ctest_jmp, 1);
 }
 
 int ctest_failed(void) {
@@ -423,8 +835,24 @@ static const char **ctest_status_string = 0;
 static ctest * ctest_head;
 static ctest ** ctest_tail_p = &ctest_head;
 
+#ifdef CTEST_RUNNER
+static const char * ctest_module;
+static int ctest_module_len;
+#endif
+
 void ctest_register(ctest * test) {
     assert(ctest_tail_p && "cannot ctest_register after running tests");
+#ifdef CTEST_RUNNER
+    if (ctest_module) {
+        // qualify tests by the name of the module being loaded
+        size_t len = ctest_module_len + 1 + strlen(test->name) + 1;
+        char * name = malloc(len);
+        if (name) {
+            snprintf(name, len, "%.*s.%s", ctest_module_len, ctest_module, test->name);
+            test->name = name;
+        }
+    }
+#endif
     test->_next = 0;
     *ctest_tail_p = test;
     ctest_tail_p = &test->_next;
@@ -433,116 +861,1564 @@ void ctest_register(ctest * test) {
 #define CTEST_FOR_EACH(n) \
     for (ctest * n = ctest_head; n; n = n->_next)
 
-static void ctest_run(ctest * t) {
-    ctest_status = CTEST_RUNNING;
-    fprintf(stdout, "%s: %s\n", ctest_status_string[ctest_status], t->name);
+/* data driven tests */
+#define CTEST_DATA_REPORT 10
 
-    if (t->_init)
-        if (setjmp(ctest_longjmp_env) == 0)
-            t->_init();
+static const char * ctest_filter;
 
-    if (ctest_status == CTEST_RUNNING) {
-        if (setjmp(ctest_longjmp_env) == 0)
-            t->_exec();
-        if (ctest_status == CTEST_RUNNING)
-            ctest_status = CTEST_SUCCESS;
-        if (t->_drop)
-            t->_drop();
+static int ctest_match(const char * str, const char * rex);
+
+struct ctest_mapping {
+    const unsigned char * base;
+    size_t size;
+};
+
+static int ctest_map_cases(ctest * t, struct ctest_mapping * map) {
+    map->base = 0;
+    map->size = 0;
+
+    int fd = open(t->_cases->path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stdout, "Cannot open %s.\n", t->_cases->path);
+        if (fd >= 0)
+            close(fd);
+        return -1;
     }
 
-    t->_status = ctest_status;
-    fprintf(stdout, "%s: %s\n", ctest_status_string[ctest_status], t->name);
+    map->size = st.st_size;
+    if (map->size > 0) {
+        void * base = mmap(0, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+            fprintf(stdout, "Cannot map %s.\n", t->_cases->path);
+            close(fd);
+            return -1;
+        }
+#if CTEST_HAVE_POSIX
+        madvise(base, map->size, MADV_SEQUENTIAL);
+#endif
+        map->base = base;
+    }
+    close(fd);
+
+    if (map->size % t->_cases->size != 0) {
+        fprintf(stdout, "Size of %s is not a multiple of record size %zu.\n",
+                t->_cases->path, t->_cases->size);
+        munmap((void *)map->base, map->size);
+        return -1;
+    }
+    return 0;
 }
 
-static void ctest_list_results(enum ctest_status status, _Bool list) {
-    size_t count = 0;
-    CTEST_FOR_EACH(node)
-        if (node->_status == status)
-            ++count;
+/* cases of a data test selected by filter */
+struct ctest_cases_filter {
+    int all;
+    size_t * idx;   // literal indices, sorted
+    size_t cnt;
+    size_t pos;
+    char rex[4096]; // wildcard patterns of indices separated by ':'
+};
 
-    if (count == 0)
-        return;
+static int ctest_size_cmp(const void * a, const void * b) {
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return (x > y) - (x < y);
+}
 
-    const char * status_str = ctest_status_string[status];
-    fprintf(stdout, "%s %zu tests.\n", status_str, count);
+/**
+ * @brief Collect cases of a test selected by filter patterns "TEST/INDEX".
+ *
+ * TEST is matched against name of the test, INDEX is a number or
+ * a wildcard pattern. Patterns without '/' select whole tests only.
+ *
+ * @return nonzero if any case may be selected
+ */
+static int ctest_cases_filter(ctest * t, struct ctest_cases_filter * cf) {
+    memset(cf, 0, sizeof *cf);
+    cf->all = !ctest_filter || ctest_match(t->name, ctest_filter);
+    if (cf->all)
+        return 1;
+
+    size_t cap = 0, rlen = 0;
+    for (const char * pat = ctest_filter; ; ++pat) {
+        size_t len = strcspn(pat, ":");
+        const char * slash = pat + len;
+        while (slash > pat && *slash != '/')
+            --slash;
+        size_t plen = slash - pat, ilen = len - plen - 1;
+        char prefix[4096];
+        int own = 0;
+        if (*slash == '/' && ilen > 0 && plen < sizeof prefix) {
+            memcpy(prefix, pat, plen);
+            prefix[plen] = 0;
+            own = ctest_match(t->name, prefix);
+        }
 
-    if (list) {
-        CTEST_FOR_EACH(node)
-            if (node->_status == status)
-                fprintf(stdout, "%s %s\n", status_str, node->name);
+        if (own && strspn(slash + 1, "0123456789") >= ilen) {
+            if (cf->cnt == cap) {
+                cap = cap ? 2 * cap : 16;
+                size_t * tmp = realloc(cf->idx, cap * sizeof *tmp);
+                if (!tmp)
+                    break;
+                cf->idx = tmp;
+            }
+            cf->idx[cf->cnt++] = strtoull(slash + 1, 0, 10);
+        } else if (own && rlen + ilen + 2 <= sizeof cf->rex) {
+            if (rlen)
+                cf->rex[rlen++] = ':';
+            memcpy(cf->rex + rlen, slash + 1, ilen);
+            rlen += ilen;
+            cf->rex[rlen] = 0;
+        }
+        pat += len;
+        if (!*pat)
+            break;
     }
-}
 
-static int ctest_is_disabled(struct ctest * t) {
-    return strstr(t->name, ".DISABLED_") != 0;
+    if (cf->cnt)
+        qsort(cf->idx, cf->cnt, sizeof *cf->idx, ctest_size_cmp);
+    return cf->cnt || rlen;
 }
 
-struct ctest_config {
-    int list_tests;
-    int repeat;
-    int also_run_disabled_tests;
-    int show_help;
-    int shuffle;
-    int random_seed;
-    int is_correct;
-    int color;
-    char * filter;
-};
+/**
+ * @brief Find first selected case at or after idx, count if there is none.
+ */
+static size_t ctest_next_case(struct ctest_cases_filter * cf, size_t idx, size_t count) {
+    if (cf->all)
+        return idx;
+    for (; idx < count; ++idx) {
+        while (cf->pos < cf->cnt && cf->idx[cf->pos] < idx)
+            ++cf->pos;
+        if (cf->pos < cf->cnt && cf->idx[cf->pos] == idx)
+            return idx;
+        // without wildcards skip right to the next literal index
+        if (!cf->rex[0])
+            return cf->pos < cf->cnt && cf->idx[cf->pos] < count ? cf->idx[cf->pos] : count;
+        char name[32];
+        snprintf(name, sizeof name, "%zu", idx);
+        if (ctest_match(name, cf->rex))
+            return idx;
+    }
+    return count;
+}
 
-static int ctest_parse_int(const char * str, int * dst) {
-    return sscanf(str, "%d%c", dst, (char[1]){0}) != 1;
+static int ctest_any_case_selected(ctest * t) {
+    struct ctest_cases_filter cf;
+    int any = ctest_cases_filter(t, &cf);
+    free(cf.idx);
+    return any;
 }
 
-static struct ctest_config ctest_get_config(int * argc_p, char ** argv) {
-    struct ctest_config cfg = { .random_seed = (int)time(0) };
-    int argc = *argc_p;
+/**
+ * @brief Run each record of a data test as a separate case.
+ *
+ * Only failed cases are reported, the test fails if any of cases failed.
+ */
+static void ctest_run_cases(ctest * t) {
+    struct ctest_mapping map;
+    if (ctest_map_cases(t, &map) != 0) {
+        ctest_status = CTEST_FAILURE;
+        return;
+    }
 
-    int non_ctest_opts = 1;
-    for (int i = 1; i < argc; ++i) {
-        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
-            cfg.show_help = 1;
-        } else if (strcmp(argv[i], "--ctest_list_tests") == 0) {
-            cfg.list_tests = 1;
-        } else if (strcmp(argv[i], "--ctest_also_run_disabled_tests") == 0) {
-            cfg.also_run_disabled_tests = 1;
-        } else if (strcmp(argv[i], "--ctest_repeat") == 0) {
-            if (ctest_parse_int(argv[++i], &cfg.repeat) != 0)
-                return cfg;
-        } else if (strncmp(argv[i], "--ctest_repeat=", 15) == 0) {
-            if (ctest_parse_int(argv[i] + 15, &cfg.repeat) != 0)
-                return cfg;
-        } else if (strcmp(argv[i], "--ctest_shuffle") == 0) {
-            cfg.shuffle = 1;
-        } else if (strcmp(argv[i], "--ctest_filter") == 0) {
-            cfg.filter = argv[++i];
-        } else if (strncmp(argv[i], "--ctest_filter=", 15) == 0) {
-            cfg.filter = argv[i] + 15;
-        } else if (strcmp(argv[i], "--ctest_random_seed") == 0) {
-            if (ctest_parse_int(argv[++i], &cfg.random_seed) != 0)
-                return cfg;
-        } else if (strncmp(argv[i], "--ctest_random_seed=", 20) == 0) {
-            if (ctest_parse_int(argv[i] + 20, &cfg.random_seed) != 0)
-                return cfg;
-        } else if (strcmp(argv[i], "--ctest_color") == 0) {
-            if (ctest_parse_int(argv[++i], &cfg.color) != 0)
-                return cfg;
-        } else if (strncmp(argv[i], "--ctest_color=", 14) == 0) {
-            if (ctest_parse_int(argv[i] + 14, &cfg.color) != 0)
-                return cfg;
-        } else if (strncmp(argv[i], "--ctest_", 8) == 0) {
-            // unknown option
-            return cfg;
-        } else {
-            argv[non_ctest_opts++] = argv[i];
+    struct ctest_cases_filter cf;
+    ctest_cases_filter(t, &cf);
+    size_t rec_size = t->_cases->size;
+    size_t count = map.size / rec_size;
+    size_t run_cnt = 0, skip_cnt = 0, fail_cnt = 0;
+    size_t failed[CTEST_DATA_REPORT];
+
+    for (size_t idx = ctest_next_case(&cf, 0, count); idx < count;
+         idx = ctest_next_case(&cf, idx + 1, count)) {
+        ctest_status = CTEST_RUNNING;
+        if (setjmp(ctest_longjmp_env) == 0)
+            t->_cases->exec(map.base + idx * rec_size, idx);
+
+        ++run_cnt;
+        if (ctest_status == CTEST_SKIPPED) {
+            ++skip_cnt;
+        } else if (ctest_status == CTEST_FAILURE) {
+            if (fail_cnt < CTEST_DATA_REPORT)
+                failed[fail_cnt] = idx;
+            ++fail_cnt;
+            fprintf(stdout, "%s: %s/%zu\n", ctest_status_string[CTEST_FAILURE],
+                    t->name, idx);
         }
     }
+    munmap((void *)map.base, map.size);
+    free(cf.idx);
 
-    argv[non_ctest_opts] = 0;
-    *argc_p = non_ctest_opts;
+    fprintf(stdout, "%zu of %zu cases failed", fail_cnt, run_cnt);
+    for (size_t i = 0; i < fail_cnt && i < CTEST_DATA_REPORT; ++i)
+        fprintf(stdout, "%s%zu", i ? ", " : ", first: ", failed[i]);
+    fprintf(stdout, ".\n");
 
-    if (cfg.color == 0)
-        cfg.color = isatty(STDOUT_FILENO) ? 1 : -1;
-    cfg.is_correct = 1;
+    if (fail_cnt)
+        ctest_status = CTEST_FAILURE;
+    else if (run_cnt > 0 && skip_cnt == run_cnt)
+        ctest_status = CTEST_SKIPPED;
+    else
+        ctest_status = CTEST_RUNNING;
+}
+
+/* controlled scheduling of logical threads */
+#define CTEST_SCHED_THREADS   16
+#define CTEST_SCHED_STACK     (256 * 1024)
+#define CTEST_SCHED_MAX_STEPS 1000000
+#define CTEST_SCHED_MAX_DEPTH 16
+#define CTEST_SCHED_SEED_BITS 44 /* random bits, depth - 1 and steps above */
+#define CTEST_SCHED_DEPTH_BITS 4
+#define CTEST_SCHED_STEPS_SHIFT (CTEST_SCHED_SEED_BITS + CTEST_SCHED_DEPTH_BITS)
+#define CTEST_SCHED_FAIRNESS  64
+
+static int ctest_sched_schedules;
+static int ctest_sched_depth;
+static unsigned long long ctest_sched_seed;
+static int ctest_sched_replay;
+
+static unsigned long long ctest_mix(unsigned long long x) {
+    // splitmix64 finalizer
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+#ifdef CTEST_HAVE_UCONTEXT
+
+enum ctest_thread_state {
+    CTEST_THREAD_RUNNABLE,
+    CTEST_THREAD_JOINING,
+    CTEST_THREAD_FINISHED,
+};
+
+struct ctest_thread {
+    ucontext_t ctx;
+    jmp_buf env;
+    void (*fn)(void *);
+    void * arg;
+    void (*body)(void);
+    enum ctest_thread_state state;
+    unsigned long long prio;
+};
+
+static struct {
+    int active;
+    int aborted;
+    int count;
+    int current;
+    int depth;
+    unsigned long long rng;
+    unsigned steps;
+    unsigned streak;
+    unsigned change[CTEST_SCHED_MAX_DEPTH];
+    ucontext_t runner;
+    struct ctest_thread threads[CTEST_SCHED_THREADS];
+    char * stacks;
+    size_t guard;
+} ctest_sched;
+
+static unsigned long long ctest_sched_rand(void) {
+    return ctest_mix(ctest_sched.rng++);
+}
+
+static void ctest_sched_entry(void) {
+    struct ctest_thread * t = &ctest_sched.threads[ctest_sched.current];
+    if (setjmp(t->env) == 0) {
+        if (t->body)
+            t->body();
+        else
+            t->fn(t->arg);
+    } else {
+        ctest_sched.aborted = 1;
+    }
+    t->state = CTEST_THREAD_FINISHED;
+    setcontext(&ctest_sched.runner);
+}
+
+static int ctest_sched_spawn(void (*body)(void), void (*fn)(void *), void * arg) {
+    if (ctest_sched.count == CTEST_SCHED_THREADS)
+        return -1;
+
+    int id = ctest_sched.count++;
+    struct ctest_thread * t = &ctest_sched.threads[id];
+    t->body = body;
+    t->fn = fn;
+    t->arg = arg;
+    t->state = CTEST_THREAD_RUNNABLE;
+    // priorities below depth are reserved for change points
+    t->prio = ctest_sched.depth + (ctest_sched_rand() >> 8);
+
+    getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp = ctest_sched.stacks + ctest_sched.guard +
+                            (size_t)id * (ctest_sched.guard + CTEST_SCHED_STACK);
+    t->ctx.uc_stack.ss_size = CTEST_SCHED_STACK;
+    t->ctx.uc_link = 0;
+    makecontext(&t->ctx, ctest_sched_entry, 0);
+    return 0;
+}
+
+static int ctest_sched_enabled(int id) {
+    const struct ctest_thread * t = &ctest_sched.threads[id];
+    if (t->state == CTEST_THREAD_RUNNABLE)
+        return 1;
+    if (t->state != CTEST_THREAD_JOINING)
+        return 0;
+    for (int i = 0; i < ctest_sched.count; ++i)
+        if (i != id && ctest_sched.threads[i].state != CTEST_THREAD_FINISHED)
+            return 0;
+    return 1;
+}
+
+/**
+ * @brief Run the body under a schedule derived from the seed.
+ *
+ * Probabilistic concurrency testing: the enabled thread with the highest
+ * priority runs until the next yield point. At depth - 1 random steps
+ * the priority of the running thread drops below all initial priorities,
+ * which bounds the number of preemptions. A thread that keeps running for
+ * many yield points while others are enabled gets the lowest priority, so
+ * spin loops containing yield points terminate. The top bits of the seed hold
+ * the expected number of steps and the depth, so the seed alone replays
+ * the schedule.
+ */
+static void ctest_sched_run(void (*body)(void), unsigned long long seed) {
+    unsigned steps = seed >> CTEST_SCHED_STEPS_SHIFT;
+    ctest_sched.depth = ((seed >> CTEST_SCHED_SEED_BITS) &
+                         ((1 << CTEST_SCHED_DEPTH_BITS) - 1)) + 1;
+    ctest_sched.rng = seed & ((1ull << CTEST_SCHED_SEED_BITS) - 1);
+    for (int d = 1; d < ctest_sched.depth; ++d)
+        ctest_sched.change[d] = ctest_sched_rand() % (steps ? steps : 1);
+
+    ctest_sched.count = 0;
+    ctest_sched.aborted = 0;
+    ctest_sched.steps = 0;
+    ctest_sched.streak = 0;
+    ctest_sched.current = 0;
+    ctest_sched_spawn(body, 0, 0);
+    ctest_sched.active = 1;
+
+    while (!ctest_sched.aborted) {
+        for (int d = 1; d < ctest_sched.depth; ++d)
+            if (ctest_sched.change[d] == ctest_sched.steps)
+                ctest_sched.threads[ctest_sched.current].prio = d;
+
+        int next = -1;
+        for (int i = 0; i < ctest_sched.count; ++i)
+            if (ctest_sched_enabled(i) &&
+                (next < 0 || ctest_sched.threads[i].prio > ctest_sched.threads[next].prio))
+                next = i;
+        if (next < 0)
+            break; // all threads finished
+
+        // let spinning thread make room for others
+        if (next != ctest_sched.current || !ctest_sched_enabled(next))
+            ctest_sched.streak = 0;
+        else if (++ctest_sched.streak >= CTEST_SCHED_FAIRNESS) {
+            ctest_sched.streak = 0;
+            for (int i = 0; i < ctest_sched.count; ++i)
+                if (i != next && ctest_sched_enabled(i)) {
+                    ctest_sched.threads[next].prio = 0;
+                    next = i;
+                    break;
+                }
+        }
+
+        if (++ctest_sched.steps > CTEST_SCHED_MAX_STEPS) {
+            fprintf(stdout, "Schedule exceeded %d steps.\n", CTEST_SCHED_MAX_STEPS);
+            ctest_status = CTEST_FAILURE;
+            break;
+        }
+
+        ctest_sched.current = next;
+        ctest_jmp = &ctest_sched.threads[next].env;
+        swapcontext(&ctest_sched.runner, &ctest_sched.threads[next].ctx);
+        ctest_jmp = &ctest_longjmp_env;
+    }
+
+    ctest_sched.active = 0;
+}
+
+/**
+ * @brief Map stacks of logical threads, each above an inaccessible guard page.
+ *
+ * A stack overflow of a logical thread faults instead of corrupting
+ * the stack of its neighbour.
+ */
+static char * ctest_sched_stacks(void) {
+#if !CTEST_HAVE_POSIX
+    // anonymous mappings are hidden, stacks have no guard pages
+    return malloc((size_t)CTEST_SCHED_THREADS * CTEST_SCHED_STACK);
+#else
+    size_t guard = sysconf(_SC_PAGESIZE);
+    size_t slot = guard + CTEST_SCHED_STACK;
+    char * stacks = mmap(0, slot * CTEST_SCHED_THREADS, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stacks == MAP_FAILED)
+        return 0;
+    for (int i = 0; i < CTEST_SCHED_THREADS; ++i) {
+        if (mprotect(stacks + i * slot, guard, PROT_NONE) != 0) {
+            munmap(stacks, slot * CTEST_SCHED_THREADS);
+            return 0;
+        }
+    }
+    ctest_sched.guard = guard;
+    return stacks;
+#endif
+}
+
+void ctest__explore(void (*body)(void)) {
+    if (!ctest_sched.stacks)
+        ctest_sched.stacks = ctest_sched_stacks();
+    if (!ctest_sched.stacks) {
+        fprintf(stdout, "Cannot allocate stacks of logical threads.\n");
+        ctest_status = CTEST_FAILURE;
+        return;
+    }
+
+    unsigned long long steps = 64;
+    int count = ctest_sched_replay ? 1 : ctest_sched_schedules;
+    int run;
+    for (run = 0; run < count && ctest_status == CTEST_RUNNING; ++run) {
+        unsigned long long seed = ctest_sched_replay ? ctest_sched_seed :
+            (steps << CTEST_SCHED_STEPS_SHIFT) |
+            ((unsigned long long)(ctest_sched_depth - 1) << CTEST_SCHED_SEED_BITS) |
+            (ctest_mix(ctest_mix(ctest_sched_seed) ^ run) >> (64 - CTEST_SCHED_SEED_BITS));
+        ctest_sched_run(body, seed);
+
+        if (ctest_status == CTEST_FAILURE)
+            fprintf(stdout, "Schedule %d failed after %u steps, "
+                    "replay with --ctest_sched_seed=%llu\n",
+                    run + 1, ctest_sched.steps, seed);
+        if (ctest_sched.steps > steps)
+            steps = ctest_sched.steps < 0xFFFF ? ctest_sched.steps : 0xFFFF;
+    }
+    if (ctest_status == CTEST_RUNNING)
+        fprintf(stdout, "Explored %d schedules.\n", run);
+}
+
+void ctest_yield_point(void) {
+    if (!ctest_sched.active)
+        return;
+    struct ctest_thread * t = &ctest_sched.threads[ctest_sched.current];
+    swapcontext(&t->ctx, &ctest_sched.runner);
+}
+
+void ctest_thread(void (*fn)(void *), void * arg) {
+    if (!ctest_sched.active) {
+        fn(arg);
+        return;
+    }
+    if (ctest_sched_spawn(0, fn, arg) != 0) {
+        fprintf(stdout, "Too many logical threads, at most %d are supported.\n",
+                CTEST_SCHED_THREADS);
+        ctest_status = CTEST_FAILURE;
+        longjmp(*ctest_jmp, 1);
+    }
+    ctest_yield_point();
+}
+
+void ctest_join(void) {
+    if (!ctest_sched.active)
+        return;
+    struct ctest_thread * t = &ctest_sched.threads[ctest_sched.current];
+    t->state = CTEST_THREAD_JOINING;
+    ctest_yield_point();
+    t->state = CTEST_THREAD_RUNNABLE;
+}
+
+#else
+
+/* without coroutines logical threads run to completion when spawned */
+void ctest__explore(void (*body)(void)) {
+    body();
+}
+
+void ctest_yield_point(void) {}
+
+void ctest_thread(void (*fn)(void *), void * arg) {
+    fn(arg);
+}
+
+void ctest_join(void) {}
+
+#endif
+
+static void ctest_step(ctest * t, enum ctest__step step) {
+    if (t->_cases) {
+        if (step == CTEST__EXEC)
+            ctest_run_cases(t);
+        return;
+    }
+
+    if (t->_step)
+        t->_step(step);
+    else if (step == CTEST__INIT)
+        t->_init();
+    else if (step == CTEST__EXEC)
+        t->_exec();
+    else
+        t->_drop();
+}
+
+/* sampling profiler relies on frame pointers found in the signal context */
+#if defined(CTEST_HAVE_EXECINFO) && CTEST_HAVE_POSIX && \
+    (defined(__x86_64__) || defined(__aarch64__))
+#  define CTEST_PROFILE_SUPPORTED 1
+#else
+#  define CTEST_PROFILE_SUPPORTED 0
+#endif
+
+/* functions are named by the profiler and by impact recording */
+#if defined(CTEST_HAVE_EXECINFO) && (CTEST_PROFILE_SUPPORTED || defined(CTEST_IMPACT))
+#  if UINTPTR_MAX > 0xffffffffu
+#    define CTEST_ELF(type) Elf64_##type
+#    define CTEST_ELF_CLASS ELFCLASS64
+#  else
+#    define CTEST_ELF(type) Elf32_##type
+#    define CTEST_ELF_CLASS ELFCLASS32
+#  endif
+
+struct ctest_func {
+    uintptr_t addr;
+    uintptr_t size;
+    const char * name;
+};
+
+/* functions of a module from its symbol table, sorted by address */
+struct ctest_module {
+    struct ctest_module * next;
+    char * path;
+    struct ctest_func * funcs;
+    size_t cnt;
+};
+
+static struct ctest_module * ctest_modules;
+
+static int ctest_func_cmp(const void * a, const void * b) {
+    uintptr_t x = ((const struct ctest_func *)a)->addr;
+    uintptr_t y = ((const struct ctest_func *)b)->addr;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Read functions of an ELF file from .symtab, or .dynsym if stripped.
+ *
+ * The file stays mapped so names point into its string table.
+ */
+static void ctest_module_read(struct ctest_module * m, const char * path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return;
+    void * map = fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(CTEST_ELF(Ehdr))
+               ? mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED)
+        return;
+
+    const unsigned char * base = map;
+    size_t size = st.st_size;
+    const CTEST_ELF(Ehdr) * eh = map;
+    const CTEST_ELF(Shdr) * sh = (const void *)(base + eh->e_shoff);
+    const CTEST_ELF(Shdr) * tab = 0;
+    if (memcmp(eh->e_ident, ELFMAG, SELFMAG) == 0 && eh->e_ident[EI_CLASS] == CTEST_ELF_CLASS &&
+        eh->e_shentsize == sizeof *sh && eh->e_shoff < size &&
+        eh->e_shnum <= (size - eh->e_shoff) / sizeof *sh) {
+        for (unsigned i = 0; i < eh->e_shnum; ++i) {
+            if (sh[i].sh_type == SHT_SYMTAB || (sh[i].sh_type == SHT_DYNSYM && !tab))
+                tab = &sh[i];
+            if (sh[i].sh_type == SHT_SYMTAB)
+                break;
+        }
+    }
+    const CTEST_ELF(Shdr) * strtab = tab && tab->sh_link < eh->e_shnum ? &sh[tab->sh_link] : 0;
+    if (!strtab || tab->sh_offset > size || tab->sh_size > size - tab->sh_offset ||
+        strtab->sh_offset > size || strtab->sh_size > size - strtab->sh_offset ||
+        strtab->sh_size == 0 || base[strtab->sh_offset + strtab->sh_size - 1] != 0) {
+        munmap(map, size);
+        return;
+    }
+
+    const CTEST_ELF(Sym) * sym = (const void *)(base + tab->sh_offset);
+    const char * names = (const char *)base + strtab->sh_offset;
+    size_t cnt = tab->sh_size / sizeof *sym;
+    m->funcs = malloc(cnt * sizeof *m->funcs);
+    for (size_t i = 0; m->funcs && i < cnt; ++i) {
+        int type = sym[i].st_info & 0xf;
+        if ((type == STT_FUNC || type == STT_GNU_IFUNC) && sym[i].st_shndx != SHN_UNDEF &&
+            sym[i].st_value != 0 && sym[i].st_name < strtab->sh_size) {
+            struct ctest_func * f = &m->funcs[m->cnt++];
+            f->addr = sym[i].st_value;
+            f->size = sym[i].st_size;
+            f->name = names + sym[i].st_name;
+        }
+    }
+    if (m->cnt == 0) {
+        free(m->funcs);
+        m->funcs = 0;
+        munmap(map, size);
+        return;
+    }
+    qsort(m->funcs, m->cnt, sizeof *m->funcs, ctest_func_cmp);
+}
+
+/**
+ * @brief Find function containing an address relative to load base of a module.
+ */
+static const char * ctest_module_func(const char * path, size_t len, uintptr_t addr) {
+    struct ctest_module * m = ctest_modules;
+    while (m && (strncmp(m->path, path, len) != 0 || m->path[len] != 0))
+        m = m->next;
+    if (!m) {
+        if (!(m = calloc(1, sizeof *m)) || !(m->path = malloc(len + 1))) {
+            free(m);
+            return 0;
+        }
+        memcpy(m->path, path, len);
+        m->path[len] = 0;
+        ctest_module_read(m, m->path);
+        // path of the main program is relative to the initial directory
+        if (!m->cnt && access(m->path, F_OK) != 0)
+            ctest_module_read(m, "/proc/self/exe");
+        m->next = ctest_modules;
+        ctest_modules = m;
+    }
+
+    size_t lo = 0, hi = m->cnt;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (m->funcs[mid].addr <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return 0;
+    const struct ctest_func * f = &m->funcs[lo - 1];
+    return f->size == 0 || addr - f->addr < f->size ? f->name : 0;
+}
+
+/**
+ * @brief Find name of a function from backtrace_symbols() entry.
+ *
+ * Functions without a dynamic symbol are looked up in the symbol table of
+ * their module.
+ *
+ * @return name of length *len or NULL if the address has no symbol
+ */
+static const char * ctest_symbol(const char * str, int * len) {
+    // format is "module(symbol+offset) [address]", offset is relative to
+    // load base when symbol is missing, address is used in executables
+    // that are not position independent
+    const char * lpar = strchr(str, '(');
+    const char * rpar = lpar ? strchr(lpar, ')') : 0;
+    if (!rpar)
+        return 0;
+    const char * plus = memchr(lpar, '+', rpar - lpar);
+    if (plus && plus > lpar + 1) {
+        *len = (int)(plus - lpar - 1);
+        return lpar + 1;
+    }
+    const char * addr = plus ? plus + 1 : strchr(rpar, '[');
+    if (!addr)
+        return 0;
+    const char * name = ctest_module_func(str, lpar - str,
+                                          strtoull(addr + (*addr == '['), 0, 16));
+    if (name)
+        *len = (int)strlen(name);
+    return name;
+}
+
+#  if CTEST_PROFILE_SUPPORTED
+/**
+ * @brief Write name of a function from backtrace_symbols() entry.
+ *
+ * Addresses without a symbol are written as name of their module
+ * so samples in the same module aggregate.
+ */
+static void ctest_symbolize(FILE * f, const char * str) {
+    int len;
+    const char * name = ctest_symbol(str, &len);
+    if (name) {
+        fprintf(f, "%.*s", len, name);
+    } else {
+        const char * end = str + strcspn(str, "( ");
+        const char * base = end;
+        while (base > str && base[-1] != '/')
+            --base;
+        fprintf(f, "%.*s", (int)(end - base), base);
+    }
+}
+#  endif
+#endif
+
+static int ctest_strptr_cmp(const void * a, const void * b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+#define CTEST_PROFILE_DEPTH   62
+#define CTEST_PROFILE_SAMPLES 16384
+
+struct ctest_sample {
+    uintptr_t depth;
+    uintptr_t pc[CTEST_PROFILE_DEPTH + 1];
+};
+
+static const char * ctest_profile_dir;
+static int ctest_profile_freq;
+
+#if CTEST_PROFILE_SUPPORTED
+
+static struct ctest_sample * ctest_profile_buf;
+static unsigned ctest_profile_cnt;
+static uintptr_t ctest_profile_stack_top;
+static long ctest_profile_tid;
+
+/**
+ * @brief Find top of the logical thread stack containing sp, 0 if none does.
+ */
+static uintptr_t ctest_sched_stack_top(uintptr_t sp) {
+    uintptr_t base = (uintptr_t)ctest_sched.stacks;
+    size_t slot = ctest_sched.guard + CTEST_SCHED_STACK;
+    if (!base || sp < base || sp - base >= slot * CTEST_SCHED_THREADS)
+        return 0;
+    return base + (sp - base) / slot * slot + slot;
+}
+
+/**
+ * @brief Record a stack of the interrupted code to a preallocated slot.
+ *
+ * Only frames located between the interrupted stack pointer and the top of
+ * its stack are followed so broken frame chains are never dereferenced.
+ * That is the frame of ctest_run() on the thread running tests or the end
+ * of a logical thread stack; samples of other threads record only the pc.
+ */
+static void ctest_profile_handler(int sig, siginfo_t * info, void * context) {
+    (void)sig, (void)info;
+    ucontext_t * uc = context;
+#  if defined(__x86_64__)
+    // REG_RBP, REG_RSP and REG_RIP indices, only named with _GNU_SOURCE
+    uintptr_t fp = uc->uc_mcontext.gregs[10];
+    uintptr_t sp = uc->uc_mcontext.gregs[15];
+    uintptr_t pc = uc->uc_mcontext.gregs[16];
+#  else
+    uintptr_t fp = uc->uc_mcontext.regs[29];
+    uintptr_t sp = uc->uc_mcontext.sp;
+    uintptr_t pc = uc->uc_mcontext.pc;
+#  endif
+
+    unsigned idx = __atomic_fetch_add(&ctest_profile_cnt, 1, __ATOMIC_RELAXED);
+    if (idx >= CTEST_PROFILE_SAMPLES)
+        return;
+
+    uintptr_t top = ctest_sched_stack_top(sp);
+    if (!top && syscall(SYS_gettid) == ctest_profile_tid && sp <= ctest_profile_stack_top)
+        top = ctest_profile_stack_top;
+
+    struct ctest_sample * s = &ctest_profile_buf[idx];
+    uintptr_t depth = 0;
+    s->pc[depth++] = pc;
+    while (depth <= CTEST_PROFILE_DEPTH && fp >= sp && fp % sizeof fp == 0 &&
+           fp + 2 * sizeof fp <= top) {
+        const uintptr_t * frame = (const uintptr_t *)fp;
+        if (frame[1] == 0)
+            break;
+        // point into the call instruction rather than after it
+        s->pc[depth++] = frame[1] - 1;
+        if (frame[0] <= fp)
+            break;
+        fp = frame[0];
+    }
+    s->depth = depth;
+}
+
+static int ctest_profile_init(void) {
+    ctest_profile_buf = calloc(CTEST_PROFILE_SAMPLES, sizeof *ctest_profile_buf);
+    if (!ctest_profile_buf)
+        return -1;
+
+    if (mkdir(ctest_profile_dir, 0777) != 0 && errno != EEXIST) {
+        perror("ctest: mkdir");
+        return -1;
+    }
+
+    // load unwinder used by backtrace_symbols() before any test runs
+    void * pc = 0;
+    backtrace(&pc, 1);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_sigaction = ctest_profile_handler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    return sigaction(SIGPROF, &sa, 0);
+}
+
+static void ctest_profile_timer(int freq) {
+    struct itimerval it = { { 0, 0 }, { 0, 0 } };
+    if (freq > 0) {
+        it.it_interval.tv_usec = 1000000 / freq;
+        it.it_value = it.it_interval;
+    }
+    setitimer(ITIMER_PROF, &it, 0);
+}
+
+/**
+ * @brief Write samples of the test in folded format used by flame graphs.
+ */
+static void ctest_profile_write(ctest * t) {
+    unsigned cnt = ctest_profile_cnt;
+    unsigned dropped = 0;
+    if (cnt > CTEST_PROFILE_SAMPLES) {
+        dropped = cnt - CTEST_PROFILE_SAMPLES;
+        cnt = CTEST_PROFILE_SAMPLES;
+    }
+
+    size_t len = strlen(ctest_profile_dir) + strlen(t->name) + 16;
+    char * path = malloc(len);
+    char ** stacks = calloc(cnt + 1, sizeof *stacks);
+    FILE * f = path ? (snprintf(path, len, "%s/%s.folded", ctest_profile_dir, t->name),
+                       fopen(path, "w")) : 0;
+    if (!f || !stacks) {
+        fprintf(stdout, "Cannot write profile of %s.\n", t->name);
+        if (f)
+            fclose(f);
+        free(stacks);
+        free(path);
+        return;
+    }
+
+    // many samples share a function, aggregate stacks after symbolization
+    for (unsigned i = 0; i < cnt; ++i) {
+        struct ctest_sample * s = &ctest_profile_buf[i];
+        char ** sym = backtrace_symbols((void * const *)s->pc, s->depth);
+        size_t size = 0;
+        FILE * line = sym ? open_memstream(&stacks[i], &size) : 0;
+        if (!line) {
+            free(sym);
+            continue;
+        }
+        for (uintptr_t d = s->depth; d-- > 0; ) {
+            ctest_symbolize(line, sym[d]);
+            if (d)
+                fputc(';', line);
+        }
+        fclose(line);
+        free(sym);
+    }
+
+    unsigned valid = 0;
+    for (unsigned i = 0; i < cnt; ++i)
+        if (stacks[i])
+            stacks[valid++] = stacks[i];
+
+    qsort(stacks, valid, sizeof *stacks, ctest_strptr_cmp);
+    for (unsigned i = 0, n; i < valid; i += n) {
+        for (n = 1; i + n < valid && strcmp(stacks[i], stacks[i + n]) == 0; ++n)
+            free(stacks[i + n]);
+        fprintf(f, "%s %u\n", stacks[i], n);
+        free(stacks[i]);
+    }
+    fclose(f);
+    free(stacks);
+
+    fprintf(stdout, "Profile: %u samples written to %s", cnt, path);
+    if (dropped)
+        fprintf(stdout, ", %u dropped", dropped);
+    fprintf(stdout, ".\n");
+    free(path);
+}
+
+static void ctest_profile_start(uintptr_t stack_top) {
+    ctest_profile_stack_top = stack_top;
+    ctest_profile_tid = syscall(SYS_gettid);
+    __atomic_store_n(&ctest_profile_cnt, 0, __ATOMIC_RELAXED);
+    ctest_profile_timer(ctest_profile_freq);
+}
+
+static void ctest_profile_stop(ctest * t) {
+    ctest_profile_timer(0);
+    ctest_profile_write(t);
+}
+
+#else
+
+static int ctest_profile_init(void) {
+    fprintf(stderr, "ctest: profiling is not supported on this platform\n");
+    return -1;
+}
+
+static void ctest_profile_start(uintptr_t stack_top) { (void)stack_top; }
+static void ctest_profile_stop(ctest * t) { (void)t; }
+
+#endif
+
+/* test impact analysis, recording needs -finstrument-functions and CTEST_IMPACT */
+#define CTEST_IMPACT_BITS 16
+#define CTEST_IMPACT_SIZE (1u << CTEST_IMPACT_BITS)
+
+static FILE * ctest_impact_file;
+static uintptr_t * ctest_impact_fns;
+static volatile int ctest_impact_recording;
+static int ctest_impact_overflow;
+
+#ifdef CTEST_IMPACT
+
+/**
+ * @brief Insert an entered function to a lock-free set of the running test.
+ */
+__attribute__((no_instrument_function))
+void __cyg_profile_func_enter(void * fn, void * site) {
+    (void)site;
+    if (!ctest_impact_recording)
+        return;
+
+    uintptr_t key = (uintptr_t)fn;
+    unsigned idx = (unsigned)((key >> 4) * 0x9E3779B1u) >> (32 - CTEST_IMPACT_BITS);
+    for (unsigned probe = 0; probe < CTEST_IMPACT_SIZE; ++probe) {
+        uintptr_t * slot = &ctest_impact_fns[(idx + probe) % CTEST_IMPACT_SIZE];
+        uintptr_t old = __atomic_load_n(slot, __ATOMIC_RELAXED);
+        if (old == 0 && __atomic_compare_exchange_n(slot, &old, key, 0,
+                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            return;
+        if (old == key)
+            return;
+    }
+    ctest_impact_overflow = 1;
+}
+
+__attribute__((no_instrument_function))
+void __cyg_profile_func_exit(void * fn, void * site) {
+    (void)fn, (void)site;
+}
+
+#endif
+
+static int ctest_impact_init(const char * path) {
+#if defined(CTEST_IMPACT) && defined(CTEST_HAVE_EXECINFO)
+    ctest_impact_fns = calloc(CTEST_IMPACT_SIZE, sizeof *ctest_impact_fns);
+    ctest_impact_file = fopen(path, "w");
+    if (!ctest_impact_fns || !ctest_impact_file) {
+        fprintf(stderr, "ctest: cannot record impact to %s\n", path);
+        return -1;
+    }
+    return 0;
+#else
+    fprintf(stderr, "ctest: cannot record impact to %s, "
+                    "build with CTEST_IMPACT and -finstrument-functions\n", path);
+    return -1;
+#endif
+}
+
+static void ctest_impact_start(void) {
+    memset(ctest_impact_fns, 0, CTEST_IMPACT_SIZE * sizeof *ctest_impact_fns);
+    ctest_impact_overflow = 0;
+    ctest_impact_recording = 1;
+}
+
+/**
+ * @brief Append names of functions executed by the test to the index.
+ *
+ * Each line of the index is a name of a test followed by names of functions.
+ * A function named "*" marks a test that executed too many functions or
+ * a function without a symbol, such a test is always selected.
+ */
+static void ctest_impact_stop(ctest * t) {
+    ctest_impact_recording = 0;
+#if defined(CTEST_IMPACT) && defined(CTEST_HAVE_EXECINFO)
+    unsigned cnt = 0;
+    for (unsigned i = 0; i < CTEST_IMPACT_SIZE; ++i)
+        if (ctest_impact_fns[i])
+            ctest_impact_fns[cnt++] = ctest_impact_fns[i];
+
+    fprintf(ctest_impact_file, "%s", t->name);
+    char ** sym = cnt ? backtrace_symbols((void * const *)ctest_impact_fns, cnt) : 0;
+    int unknown = ctest_impact_overflow || (cnt && !sym);
+    for (unsigned i = 0; sym && i < cnt; ++i) {
+        int len;
+        const char * name = ctest_symbol(sym[i], &len);
+        if (name)
+            fprintf(ctest_impact_file, " %.*s", len, name);
+        else
+            unknown = 1;
+    }
+    if (unknown)
+        fprintf(ctest_impact_file, " *");
+    fputc('\n', ctest_impact_file);
+    fflush(ctest_impact_file);
+    free(sym);
+#else
+    (void)t;
+#endif
+}
+
+static char ** ctest_impact_skip;
+static size_t ctest_impact_skip_cnt;
+
+#if CTEST_HAVE_POSIX
+
+static char ** ctest_read_words(FILE * f, size_t * cnt) {
+    char ** words = 0;
+    size_t cap = 0;
+    *cnt = 0;
+    for (char word[4096]; fscanf(f, "%4095s", word) == 1; ) {
+        if (*cnt == cap) {
+            cap = cap ? 2 * cap : 64;
+            char ** tmp = realloc(words, cap * sizeof *words);
+            if (!tmp)
+                break;
+            words = tmp;
+        }
+        if (!(words[*cnt] = strdup(word)))
+            break;
+        ++*cnt;
+    }
+    return words;
+}
+
+/**
+ * @brief Find tests that are known not to execute any of changed functions.
+ *
+ * Tests missing in the index are always selected.
+ */
+static int ctest_impact_load(const char * index_path, const char * changed_path) {
+    FILE * index = index_path ? fopen(index_path, "r") : 0;
+    FILE * changed = fopen(changed_path, "r");
+    if (!index || !changed) {
+        fprintf(stderr, "ctest: cannot read impact index or changed functions\n");
+        if (index)
+            fclose(index);
+        if (changed)
+            fclose(changed);
+        return -1;
+    }
+
+    size_t changed_cnt;
+    char ** fns = ctest_read_words(changed, &changed_cnt);
+    fclose(changed);
+    qsort(fns, changed_cnt, sizeof *fns, ctest_strptr_cmp);
+
+    size_t cap = 0;
+    char * line = 0;
+    size_t size = 0;
+    while (getline(&line, &size, index) > 0) {
+        char * name = strtok(line, " \n");
+        if (!name)
+            continue;
+        int hit = 0;
+        for (char * fn; !hit && (fn = strtok(0, " \n")); )
+            hit = strcmp(fn, "*") == 0 ||
+                  bsearch(&fn, fns, changed_cnt, sizeof *fns, ctest_strptr_cmp);
+        if (hit)
+            continue;
+        if (ctest_impact_skip_cnt == cap) {
+            cap = cap ? 2 * cap : 64;
+            char ** tmp = realloc(ctest_impact_skip, cap * sizeof *tmp);
+            if (!tmp)
+                break;
+            ctest_impact_skip = tmp;
+        }
+        if (!(ctest_impact_skip[ctest_impact_skip_cnt] = strdup(name)))
+            break;
+        ++ctest_impact_skip_cnt;
+    }
+    free(line);
+    fclose(index);
+
+    for (size_t i = 0; i < changed_cnt; ++i)
+        free(fns[i]);
+    free(fns);
+
+    qsort(ctest_impact_skip, ctest_impact_skip_cnt, sizeof *ctest_impact_skip,
+          ctest_strptr_cmp);
+    return 0;
+}
+
+#else
+
+static int ctest_impact_load(const char * index_path, const char * changed_path) {
+    (void)index_path, (void)changed_path;
+    fprintf(stderr, "ctest: impact selection needs POSIX interfaces\n");
+    return -1;
+}
+
+#endif
+
+static int ctest_is_impacted(ctest * t) {
+    return !ctest_impact_skip_cnt ||
+           !bsearch(&t->name, ctest_impact_skip, ctest_impact_skip_cnt,
+                    sizeof *ctest_impact_skip, ctest_strptr_cmp);
+}
+
+/* execution environment for stable timing */
+#define CTEST_CPU_WORDS        16
+#define CTEST_WORD_BITS        (8 * (int)sizeof(unsigned long))
+#define CTEST_PREFAULT_STACK   (1 << 20)
+#define CTEST_PREFAULT_HEAP    (64 << 20)
+#define CTEST_COLD_CACHE_SIZE  (64 << 20)
+#define CTEST_SMT_SAMPLE_US    100000
+
+static unsigned char * ctest_cold_cache;
+static size_t ctest_cold_cache_size;
+
+static int ctest_read_line(const char * path, char * buf, int size) {
+    FILE * f = fopen(path, "r");
+    if (!f)
+        return -1;
+    int ok = fgets(buf, size, f) != 0;
+    fclose(f);
+    if (!ok)
+        return -1;
+    buf[strcspn(buf, "\n")] = 0;
+    return 0;
+}
+
+#if defined(__linux__) && CTEST_HAVE_POSIX
+
+/**
+ * @brief Parse list of CPUs like "0-3,6" to a mask.
+ */
+static int ctest_parse_cpus(const char * str, unsigned long * mask) {
+    memset(mask, 0, CTEST_CPU_WORDS * sizeof *mask);
+    for (;;) {
+        int lo, hi, len;
+        if (sscanf(str, "%d%n", &lo, &len) != 1)
+            return -1;
+        str += len;
+        hi = lo;
+        if (*str == '-') {
+            if (sscanf(str + 1, "%d%n", &hi, &len) != 1)
+                return -1;
+            str += len + 1;
+        }
+        if (lo < 0 || hi < lo || hi >= CTEST_CPU_WORDS * CTEST_WORD_BITS)
+            return -1;
+        for (int cpu = lo; cpu <= hi; ++cpu)
+            mask[cpu / CTEST_WORD_BITS] |= 1ul << (cpu % CTEST_WORD_BITS);
+        if (*str != ',')
+            return *str == 0 || *str == '\n' ? 0 : -1;
+        ++str;
+    }
+}
+
+static int ctest_has_cpu(const unsigned long * mask, int cpu) {
+    return (mask[cpu / CTEST_WORD_BITS] >> (cpu % CTEST_WORD_BITS)) & 1;
+}
+
+static void ctest_sleep_us(long us) {
+    ctest_sleep_ns(us * 1000LL);
+}
+
+static int ctest_set_cpus(const char * list) {
+    unsigned long mask[CTEST_CPU_WORDS];
+    if (ctest_parse_cpus(list, mask) != 0) {
+        fprintf(stderr, "ctest: invalid list of CPUs: %s\n", list);
+        return -1;
+    }
+    // workers forked later inherit the affinity
+    if (syscall(SYS_sched_setaffinity, 0, sizeof mask, mask) != 0) {
+        perror("ctest: sched_setaffinity");
+        return -1;
+    }
+    return 0;
+}
+
+static int ctest_get_cpus(unsigned long * mask) {
+    memset(mask, 0, CTEST_CPU_WORDS * sizeof *mask);
+    return syscall(SYS_sched_getaffinity, 0, CTEST_CPU_WORDS * sizeof *mask, mask) < 0;
+}
+
+/**
+ * @brief Read busy and total time of a CPU from /proc/stat.
+ */
+static int ctest_cpu_times(int cpu, unsigned long long * busy, unsigned long long * total) {
+    FILE * f = fopen("/proc/stat", "r");
+    if (!f)
+        return -1;
+    char line[512];
+    int found = 0;
+    while (!found && fgets(line, sizeof line, f)) {
+        unsigned long long v[8] = { 0 };
+        int id;
+        if (sscanf(line, "cpu%d %llu %llu %llu %llu %llu %llu %llu %llu", &id,
+                   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) < 5 ||
+            id != cpu)
+            continue;
+        *total = v[0] + v[1] + v[2] + v[3] + v[4] + v[5] + v[6] + v[7];
+        *busy = *total - v[3] - v[4]; // idle and iowait
+        found = 1;
+    }
+    fclose(f);
+    return found ? 0 : -1;
+}
+
+/**
+ * @brief Print the environment and warn about sources of timing noise.
+ */
+static void ctest_check_env(void) {
+    char buf[256], path[128];
+    unsigned long cpus[CTEST_CPU_WORDS];
+    if (ctest_get_cpus(cpus) != 0)
+        return;
+
+    fprintf(stdout, "Environment:\n  CPUs:");
+    for (int cpu = 0; cpu < CTEST_CPU_WORDS * CTEST_WORD_BITS; ++cpu)
+        if (ctest_has_cpu(cpus, cpu))
+            fprintf(stdout, " %d", cpu);
+    fprintf(stdout, "\n");
+
+    int warnings = 0;
+    unsigned long siblings[CTEST_CPU_WORDS] = { 0 };
+    for (int cpu = 0; cpu < CTEST_CPU_WORDS * CTEST_WORD_BITS; ++cpu) {
+        if (!ctest_has_cpu(cpus, cpu))
+            continue;
+
+        snprintf(path, sizeof path,
+                 "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu);
+        if (ctest_read_line(path, buf, sizeof buf) == 0) {
+            fprintf(stdout, "  cpu%d governor: %s\n", cpu, buf);
+            if (strcmp(buf, "performance") != 0) {
+                fprintf(stdout, "Warning: governor of cpu%d is not performance.\n", cpu);
+                ++warnings;
+            }
+        }
+
+        unsigned long mask[CTEST_CPU_WORDS];
+        snprintf(path, sizeof path,
+                 "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+        if (ctest_read_line(path, buf, sizeof buf) == 0 && ctest_parse_cpus(buf, mask) == 0)
+            for (int i = 0; i < CTEST_CPU_WORDS; ++i)
+                siblings[i] |= mask[i] & ~cpus[i];
+    }
+
+    int turbo = -1;
+    if (ctest_read_line("/sys/devices/system/cpu/intel_pstate/no_turbo", buf, sizeof buf) == 0)
+        turbo = strcmp(buf, "0") == 0;
+    else if (ctest_read_line("/sys/devices/system/cpu/cpufreq/boost", buf, sizeof buf) == 0)
+        turbo = strcmp(buf, "1") == 0;
+    if (turbo >= 0)
+        fprintf(stdout, "  turbo: %s\n", turbo ? "on" : "off");
+    if (turbo > 0) {
+        fprintf(stdout, "Warning: turbo boost is enabled.\n");
+        ++warnings;
+    }
+
+    // sample utilization of SMT siblings not used by tests
+    unsigned long long busy0[CTEST_CPU_WORDS * CTEST_WORD_BITS];
+    unsigned long long total0[CTEST_CPU_WORDS * CTEST_WORD_BITS];
+    int sampled = 0;
+    for (int cpu = 0; cpu < CTEST_CPU_WORDS * CTEST_WORD_BITS; ++cpu)
+        if (ctest_has_cpu(siblings, cpu))
+            sampled += ctest_cpu_times(cpu, &busy0[cpu], &total0[cpu]) == 0;
+    if (sampled)
+        ctest_sleep_us(CTEST_SMT_SAMPLE_US);
+    for (int cpu = 0; sampled && cpu < CTEST_CPU_WORDS * CTEST_WORD_BITS; ++cpu) {
+        unsigned long long busy, total;
+        if (!ctest_has_cpu(siblings, cpu) || ctest_cpu_times(cpu, &busy, &total) != 0)
+            continue;
+        if (total > total0[cpu] && (busy - busy0[cpu]) * 10 > total - total0[cpu]) {
+            fprintf(stdout, "Warning: SMT sibling cpu%d is busy.\n", cpu);
+            ++warnings;
+        }
+    }
+
+    double load;
+    if (ctest_read_line("/proc/loadavg", buf, sizeof buf) == 0 &&
+        sscanf(buf, "%lf", &load) == 1) {
+        fprintf(stdout, "  load average: %.2f\n", load);
+        if (load >= 1.0) {
+            fprintf(stdout, "Warning: load average is high.\n");
+            ++warnings;
+        }
+    }
+
+    if (warnings)
+        fprintf(stdout, "Timing results may be unstable.\n");
+    fprintf(stdout, "\n");
+}
+
+#else
+
+static int ctest_set_cpus(const char * list) {
+    fprintf(stderr, "ctest: cannot set CPUs %s on this platform\n", list);
+    return -1;
+}
+
+static void ctest_check_env(void) {}
+
+#endif
+
+static __attribute__((noinline)) void ctest_prefault_stack(void) {
+    volatile char stack[CTEST_PREFAULT_STACK];
+    for (size_t i = 0; i < sizeof stack; i += 64)
+        stack[i] = 0;
+}
+
+/**
+ * @brief Fault in stack and heap and lock them in memory.
+ */
+static void ctest_lock_memory(void) {
+    ctest_prefault_stack();
+
+#ifdef __GLIBC__
+    // keep freed memory in the heap instead of returning it to the system
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    char * heap = malloc(CTEST_PREFAULT_HEAP);
+    if (heap) {
+        for (size_t i = 0; i < CTEST_PREFAULT_HEAP; i += 64)
+            heap[i] = 0;
+        free(heap);
+    }
+#endif
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        fprintf(stdout, "Warning: cannot lock memory: %s.\n", strerror(errno));
+}
+
+/**
+ * @brief Evict caches by touching a buffer larger than the last level cache.
+ */
+static void ctest_evict_caches(void) {
+    for (size_t i = 0; i < ctest_cold_cache_size; i += 64)
+        ctest_cold_cache[i] += 1;
+}
+
+static size_t ctest_cache_size(void) {
+    size_t size = 0;
+    for (int idx = 0; idx < 8; ++idx) {
+        char path[96], buf[32];
+        unsigned long kb;
+        snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu0/cache/index%d/size", idx);
+        if (ctest_read_line(path, buf, sizeof buf) == 0 &&
+            sscanf(buf, "%luK", &kb) == 1 && kb * 1024 > size)
+            size = kb * 1024;
+    }
+    // twice the last level cache defeats most replacement policies
+    return size ? 2 * size : CTEST_COLD_CACHE_SIZE;
+}
+
+static void ctest_run(ctest * t) {
+    ctest_status = CTEST_RUNNING;
+    fprintf(stdout, "%s: %s\n", ctest_status_string[ctest_status], t->name);
+
+    if (ctest_cold_cache)
+        ctest_evict_caches();
+    if (ctest_impact_file)
+        ctest_impact_start();
+    ctest_clock_reset();
+
+    if (t->_init || t->_step || t->_cases)
+        if (setjmp(ctest_longjmp_env) == 0)
+            ctest_step(t, CTEST__INIT);
+
+    if (ctest_status == CTEST_RUNNING) {
+        if (ctest_profile_dir)
+            ctest_profile_start((uintptr_t)__builtin_frame_address(0));
+        if (setjmp(ctest_longjmp_env) == 0)
+            ctest_step(t, CTEST__EXEC);
+        if (ctest_profile_dir)
+            ctest_profile_stop(t);
+        if (ctest_status == CTEST_RUNNING)
+            ctest_status = CTEST_SUCCESS;
+        if (t->_drop || t->_step || t->_cases)
+            ctest_step(t, CTEST__DROP);
+    }
+
+    ctest_clock_stop();
+    if (ctest_impact_file)
+        ctest_impact_stop(t);
+
+    t->_status = ctest_status;
+    fprintf(stdout, "%s: %s\n", ctest_status_string[ctest_status], t->name);
+}
+
+static void ctest_list_results(enum ctest_status status, _Bool list) {
+    size_t count = 0;
+    CTEST_FOR_EACH(node)
+        if (node->_status == status)
+            ++count;
+
+    if (count == 0)
+        return;
+
+    const char * status_str = ctest_status_string[status];
+    fprintf(stdout, "%s %zu tests.\n", status_str, count);
+
+    if (list) {
+        CTEST_FOR_EACH(node)
+            if (node->_status == status)
+                fprintf(stdout, "%s %s\n", status_str, node->name);
+    }
+}
+
+static int ctest_is_disabled(struct ctest * t) {
+    return strstr(t->name, ".DISABLED_") != 0;
+}
+
+struct ctest_config {
+    int list_tests;
+    int repeat;
+    int also_run_disabled_tests;
+    int show_help;
+    int shuffle;
+    int random_seed;
+    int is_correct;
+    int color;
+    char * filter;
+    char * serve;
+    char * connect;
+    char * load;
+    char * profile;
+    int profile_freq;
+    char * record_impact;
+    char * impact_index;
+    char * impacted_by;
+    int schedules;
+    int sched_depth;
+    unsigned long long sched_seed;
+    int sched_replay;
+    char * cpus;
+    int mlock;
+    int check_env;
+    int cold_cache;
+};
+
+static int ctest_parse_int(const char * str, int * dst) {
+    return sscanf(str, "%d%c", dst, (char[1]){0}) != 1;
+}
+
+static int ctest_parse_ullong(const char * str, unsigned long long * dst) {
+    return sscanf(str, "%llu%c", dst, (char[1]){0}) != 1;
+}
+
+static struct ctest_config ctest_get_config(int * argc_p, char ** argv) {
+    struct ctest_config cfg = {
+        .random_seed = (int)time(0),
+        .profile_freq = 1000,
+        .schedules = 1000,
+        .sched_depth = 3,
+    };
+    int argc = *argc_p;
+
+    int non_ctest_opts = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            cfg.show_help = 1;
+        } else if (strcmp(argv[i], "--ctest_list_tests") == 0) {
+            cfg.list_tests = 1;
+        } else if (strcmp(argv[i], "--ctest_also_run_disabled_tests") == 0) {
+            cfg.also_run_disabled_tests = 1;
+        } else if (strcmp(argv[i], "--ctest_repeat") == 0) {
+            if (ctest_parse_int(argv[++i], &cfg.repeat) != 0)
+                return cfg;
+        } else if (strncmp(argv[i], "--ctest_repeat=", 15) == 0) {
+            if (ctest_parse_int(argv[i] + 15, &cfg.repeat) != 0)
+                return cfg;
+        } else if (strcmp(argv[i], "--ctest_shuffle") == 0) {
+            cfg.shuffle = 1;
+        } else if (strcmp(argv[i], "--ctest_filter") == 0) {
+            cfg.filter = argv[++i];
+        } else if (strncmp(argv[i], "--ctest_filter=", 15) == 0) {
+            cfg.filter = argv[i] + 15;
+        } else if (strcmp(argv[i], "--ctest_random_seed") == 0) {
+            if (ctest_parse_int(argv[++i], &cfg.random_seed) != 0)
+                return cfg;
+        } else if (strncmp(argv[i], "--ctest_random_seed=", 20) == 0) {
+            if (ctest_parse_int(argv[i] + 20, &cfg.random_seed) != 0)
+                return cfg;
+        } else if (strcmp(argv[i], "--ctest_color") == 0) {
+            if (ctest_parse_int(argv[++i], &cfg.color) != 0)
+                return cfg;
+        } else if (strncmp(argv[i], "--ctest_color=", 14) == 0) {
+            if (ctest_parse_int(argv[i] + 14, &cfg.color) != 0)
+                return cfg;
+        } else if (strcmp(argv[i], "--ctest_profile") == 0) {
+            cfg.profile = argv[++i];
+        } else if (strncmp(argv[i], "--ctest_profile=", 16) == 0) {
+            cfg.profile = argv[i] + 16;
+        } else if (strcmp(argv[i], "--ctest_profile_freq") == 0) {
+            if (ctest_parse_int(argv[++i], &cfg.profile_freq) != 0)
+                return cfg;
+        } else if (strncmp(argv[i], "--ctest_profile_freq=", 21) == 0) {
+            if (ctest_parse_int(argv[i] + 21, &cfg.profile_freq) != 0)
+                return cfg;
+        } else if (strcmp(argv[i], "--ctest_record_impact") == 0) {
+            cfg.record_impact = argv[++i];
+        } else if (strncmp(argv[i], "--ctest_record_impact=", 22) == 0) {
+            cfg.record_impact = argv[i] + 22;
+        } else if (strcmp(argv[i], "--ctest_impact_index") == 0) {
+            cfg.impact_index = argv[++i];
+        } else if (strncmp(argv[i], "--ctest_impact_index=", 21) == 0) {
+            cfg.impact_index = argv[i] + 21;
+        } else if (strcmp(argv[i], "--ctest_impacted_by") == 0) {
+            cfg.impacted_by = argv[++i];
+        } else if (strncmp(argv[i], "--ctest_impacted_by=", 20) == 0) {
+            cfg.impacted_by = argv[i] + 20;
+        } else if (strcmp(argv[i], "--ctest_schedules") == 0) {
+            if (ctest_parse_int(argv[++i], &cfg.schedules) != 0)
+                return cfg;
+        } else if (strncmp(argv[i], "--ctest_schedules=", 18) == 0) {
+            if (ctest_parse_int(argv[i] + 18, &cfg.schedules) != 0)
+                return cfg;
+        } else if (strcmp(argv[i], "--ctest_sched_depth") == 0) {
+            if (ctest_parse_int(argv[++i], &cfg.sched_depth) != 0)
+                return cfg;
+        } else if (strncmp(argv[i], "--ctest_sched_depth=", 20) == 0) {
+            if (ctest_parse_int(argv[i] + 20, &cfg.sched_depth) != 0)
+                return cfg;
+        } else if (strcmp(argv[i], "--ctest_sched_seed") == 0) {
+            if (ctest_parse_ullong(argv[++i], &cfg.sched_seed) != 0)
+                return cfg;
+            cfg.sched_replay = 1;
+        } else if (strncmp(argv[i], "--ctest_sched_seed=", 19) == 0) {
+            if (ctest_parse_ullong(argv[i] + 19, &cfg.sched_seed) != 0)
+                return cfg;
+            cfg.sched_replay = 1;
+        } else if (strcmp(argv[i], "--ctest_cpu") == 0) {
+            cfg.cpus = argv[++i];
+        } else if (strncmp(argv[i], "--ctest_cpu=", 12) == 0) {
+            cfg.cpus = argv[i] + 12;
+        } else if (strcmp(argv[i], "--ctest_mlock") == 0) {
+            cfg.mlock = 1;
+        } else if (strcmp(argv[i], "--ctest_check_env") == 0) {
+            cfg.check_env = 1;
+        } else if (strcmp(argv[i], "--ctest_cold_cache") == 0) {
+            cfg.cold_cache = 1;
+        } else if (strcmp(argv[i], "--ctest_serve") == 0) {
+            cfg.serve = argv[++i];
+        } else if (strncmp(argv[i], "--ctest_serve=", 14) == 0) {
+            cfg.serve = argv[i] + 14;
+        } else if (strcmp(argv[i], "--ctest_connect") == 0) {
+            cfg.connect = argv[++i];
+        } else if (strncmp(argv[i], "--ctest_connect=", 16) == 0) {
+            cfg.connect = argv[i] + 16;
+#ifdef CTEST_RUNNER
+        } else if (strcmp(argv[i], "--ctest_load") == 0) {
+            cfg.load = argv[++i];
+        } else if (strncmp(argv[i], "--ctest_load=", 13) == 0) {
+            cfg.load = argv[i] + 13;
+#endif
+        } else if (strncmp(argv[i], "--ctest_", 8) == 0) {
+            // unknown option
+            return cfg;
+        } else {
+            argv[non_ctest_opts++] = argv[i];
+        }
+    }
+
+    argv[non_ctest_opts] = 0;
+    *argc_p = non_ctest_opts;
+
+    if (cfg.color == 0)
+        cfg.color = isatty(STDOUT_FILENO) ? 1 : -1;
+    if (cfg.sched_depth < 1 || cfg.sched_depth > CTEST_SCHED_MAX_DEPTH)
+        return cfg;
+    if (cfg.profile_freq < 1 || cfg.profile_freq > 1000000)
+        return cfg;
+    if (!cfg.sched_replay)
+        cfg.sched_seed = (unsigned)cfg.random_seed;
+    cfg.is_correct = 1;
 
     return cfg;
 }
@@ -559,6 +2435,23 @@ static void ctest_show_help(void) {
         "--ctest_repeat=INTEGER\n\tRepeat tests given times.\n"
         "--ctest_shuffle\n\tShuffle tests at each iteration.\n"
         "--ctest_random_seed\n\tRandom seed for shuffling.\n"
+        "--ctest_profile=DIR\n\tWrite folded stacks sampled from each test to DIR.\n"
+        "--ctest_profile_freq=INTEGER\n\tSampling frequency in Hz, default 1000.\n"
+        "--ctest_record_impact=FILE\n\tWrite functions executed by each test to FILE.\n"
+        "--ctest_impact_index=FILE\n\tIndex written by --ctest_record_impact.\n"
+        "--ctest_impacted_by=FILE\n\tRun only tests executing functions listed in FILE.\n"
+        "--ctest_schedules=INTEGER\n\tSchedules explored by TEST_SCHED, default 1000.\n"
+        "--ctest_sched_depth=INTEGER\n\tPriority change points per schedule, default 3.\n"
+        "--ctest_sched_seed=INTEGER\n\tReplay a single schedule printed on failure.\n"
+        "--ctest_cpu=LIST\n\tRun on CPUs from LIST, e.g. 2,3 or 4-7.\n"
+        "--ctest_mlock\n\tFault in and lock stack and heap.\n"
+        "--ctest_check_env\n\tPrint environment, warn about timing noise.\n"
+        "--ctest_cold_cache\n\tEvict caches before each test.\n"
+        "--ctest_serve=PATH\n\tStay resident and run requests from a unix socket.\n"
+        "--ctest_connect=PATH\n\tSend other options to a resident server.\n"
+#ifdef CTEST_RUNNER
+        "--ctest_load=PATH[:PATH...]\n\tLoad tests from shared objects.\n"
+#endif
     );
 }
 
@@ -604,14 +2497,35 @@ static int ctest_match(const char * str, const char * rex) {
     return 0;
 }
 
+static int ctest_selected(ctest * t) {
+    if (!ctest_filter || ctest_match(t->name, ctest_filter))
+        return 1;
+    return t->_cases && ctest_any_case_selected(t);
+}
+
 static void ctest_select_tests(struct ctest_config cfg) {
+    ctest_filter = cfg.filter;
     ctest ** prev = &ctest_head;
-    CTEST_FOR_EACH(node)
-        if (!cfg.filter || ctest_match(node->name, cfg.filter)) {
+    int selected = 0, skipped = 0;
+    CTEST_FOR_EACH(node) {
+        if (!ctest_selected(node))
+            continue;
+        ++selected;
+        if (ctest_is_impacted(node)) {
             *prev = node;
             prev = &node->_next;
+        } else {
+            ++skipped;
         }
+    }
     *prev = 0;
+
+    // selecting nothing by impact is legitimate but must never go unnoticed
+    if (cfg.impacted_by) {
+        fprintf(stdout, "Impact analysis skipped %d of %d tests.\n", skipped, selected);
+        if (selected && skipped == selected)
+            fprintf(stdout, "No test executed any of changed functions.\n");
+    }
 }
 
 static ctest * ctest_shuffle_run_list(ctest * head) {
@@ -683,18 +2597,13 @@ static size_t ctest_run_tests(struct ctest_config cfg) {
     return failure_cnt;
 }
 
-int ctest_main(int * argc_p, char *argv[]) {
-    struct ctest_config cfg = ctest_get_config(argc_p, argv);
-    ctest_tail_p = 0; // freeze tests
-
-    if (!cfg.is_correct || cfg.show_help) {
-        ctest_show_help();
-        return EXIT_FAILURE;
-    }
-
+static int ctest_run_main(struct ctest_config cfg) {
     ctest_status_string = cfg.color > 0 ? ctest_status_color_string
                                         : ctest_status_mono_string;
 
+    if (cfg.impacted_by && ctest_impact_load(cfg.impact_index, cfg.impacted_by) != 0)
+        return EXIT_FAILURE;
+
     ctest_select_tests(cfg);
 
     if (cfg.list_tests) {
@@ -703,6 +2612,36 @@ int ctest_main(int * argc_p, char *argv[]) {
         return EXIT_SUCCESS;
     }
 
+    if (cfg.profile) {
+        ctest_profile_dir = cfg.profile;
+        ctest_profile_freq = cfg.profile_freq;
+        if (ctest_profile_init() != 0)
+            return EXIT_FAILURE;
+    }
+
+    ctest_sched_schedules = cfg.schedules;
+    ctest_sched_depth = cfg.sched_depth;
+    ctest_sched_seed = cfg.sched_seed;
+    ctest_sched_replay = cfg.sched_replay;
+
+    if (cfg.cpus && ctest_set_cpus(cfg.cpus) != 0)
+        return EXIT_FAILURE;
+    if (cfg.check_env)
+        ctest_check_env();
+    if (cfg.mlock)
+        ctest_lock_memory();
+    if (cfg.cold_cache) {
+        ctest_cold_cache_size = ctest_cache_size();
+        ctest_cold_cache = calloc(ctest_cold_cache_size, 1);
+        if (!ctest_cold_cache)
+            return EXIT_FAILURE;
+        fprintf(stdout, "Evicting caches with %zu bytes before each test.\n",
+                ctest_cold_cache_size);
+    }
+
+    if (cfg.record_impact && ctest_impact_init(cfg.record_impact) != 0)
+        return EXIT_FAILURE;
+
     if (cfg.shuffle) {
         fprintf(stdout, "Random seed is %d.\n", cfg.random_seed);
         srand(cfg.random_seed);
@@ -721,4 +2660,296 @@ int ctest_main(int * argc_p, char *argv[]) {
     return failure_cnt == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
+#define CTEST_SERVE_MAX_ARGS 64
+/* the exit status follows the test output as a fixed size trailer */
+#define CTEST_SERVE_TRAILER "\0ctest:"
+#define CTEST_SERVE_TRAILER_LEN (sizeof CTEST_SERVE_TRAILER)
+
+static int ctest_socket(const char * path, struct sockaddr_un * addr) {
+    memset(addr, 0, sizeof *addr);
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof addr->sun_path) {
+        fprintf(stderr, "ctest: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        perror("ctest: socket");
+    return fd;
+}
+
+static int ctest_write_all(int fd, const char * buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Split a request of NUL terminated ctest options into argv.
+ *
+ * @return number of arguments or -1 if the request is malformed
+ */
+static int ctest_serve_args(char * req, size_t len, char * prog, char ** argv) {
+    int argc = 0;
+    argv[argc++] = prog;
+    for (size_t i = 0; i < len; i += strlen(req + i) + 1) {
+        if (argc > CTEST_SERVE_MAX_ARGS || !memchr(req + i, 0, len - i))
+            return -1;
+        argv[argc++] = req + i;
+    }
+    argv[argc] = 0;
+    return argc;
+}
+
+/**
+ * @brief Serve a single connection in a child forked from the resident process.
+ *
+ * The request is read until the client shuts down its side of the connection.
+ * Tests run in another child writing its output directly to the connection,
+ * this one waits for it and sends the exit status in the trailer.
+ */
+static void ctest_serve_conn(int conn, char * prog, const struct ctest_config * server) {
+    // the resident process ignores SIGCHLD, waitpid() needs the default
+    signal(SIGCHLD, SIG_DFL);
+
+    static char req[4096];
+    size_t len = 0;
+    ssize_t n;
+    while (len < sizeof req && (n = read(conn, req + len, sizeof req - len)) != 0) {
+        if (n < 0 && errno != EINTR)
+            break;
+        if (n > 0)
+            len += n;
+    }
+
+    char * argv[CTEST_SERVE_MAX_ARGS + 2];
+    int argc = len < sizeof req ? ctest_serve_args(req, len, prog, argv) : -1;
+    char msg[128];
+    int ret = EXIT_FAILURE, status = 0;
+
+    pid_t pid = argc < 0 ? 0 : fork();
+    if (pid == 0 && argc >= 0) {
+        dup2(conn, STDOUT_FILENO);
+        dup2(conn, STDERR_FILENO);
+        close(conn);
+
+        struct ctest_config cfg = ctest_get_config(&argc, argv);
+        // memory locks and cache buffers are not inherited, CPU affinity is
+        cfg.mlock |= server->mlock;
+        cfg.cold_cache |= server->cold_cache;
+        if (!cfg.is_correct || cfg.show_help || cfg.serve || cfg.connect) {
+            ctest_show_help();
+            ret = EXIT_FAILURE;
+        } else {
+            ret = ctest_run_main(cfg);
+        }
+        fflush(stdout);
+        fflush(stderr);
+        _exit(ret);
+    }
+
+    if (argc < 0) {
+        ctest_write_all(conn, msg, snprintf(msg, sizeof msg, "ctest: malformed request\n"));
+    } else if (pid < 0) {
+        perror("ctest: fork");
+    } else {
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+            ;
+        if (WIFEXITED(status)) {
+            ret = WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+            ctest_write_all(conn, msg, snprintf(msg, sizeof msg,
+                            "Test process killed by signal %d.\n", WTERMSIG(status)));
+        }
+    }
+
+    memcpy(msg, CTEST_SERVE_TRAILER, CTEST_SERVE_TRAILER_LEN - 1);
+    msg[CTEST_SERVE_TRAILER_LEN - 1] = (char)ret;
+    ctest_write_all(conn, msg, CTEST_SERVE_TRAILER_LEN);
+    close(conn);
+    _exit(0);
+}
+
+static int ctest_serve(struct ctest_config cfg, char * prog) {
+    const char * path = cfg.serve;
+    if (cfg.cpus && ctest_set_cpus(cfg.cpus) != 0)
+        return EXIT_FAILURE;
+    if (cfg.check_env)
+        ctest_check_env();
+
+    struct sockaddr_un addr;
+    int fd = ctest_socket(path, &addr);
+    if (fd < 0)
+        return EXIT_FAILURE;
+
+    // remove stale socket left by previous server, never other files
+#if CTEST_HAVE_POSIX
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+#endif
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof addr) != 0 || listen(fd, 8) != 0) {
+        perror("ctest: bind");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    // a client leaving early must not kill the server,
+    // connections are served concurrently and reaped by the kernel
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGCHLD, SIG_IGN);
+
+    fprintf(stdout, "Serving tests at %s.\n", path);
+    fflush(stdout);
+
+    for (;;) {
+        int conn = accept(fd, 0, 0);
+        if (conn < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("ctest: accept");
+            break;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fd);
+            ctest_serve_conn(conn, prog, &cfg);
+        }
+        if (pid < 0)
+            perror("ctest: fork");
+        close(conn);
+    }
+
+    close(fd);
+    return EXIT_FAILURE;
+}
+
+static int ctest_connect(const char * path, int argc, char ** argv) {
+    struct sockaddr_un addr;
+    int fd = ctest_socket(path, &addr);
+    if (fd < 0)
+        return EXIT_FAILURE;
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof addr) != 0) {
+        perror("ctest: connect");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    // forward all options except the ones selecting the client mode
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--ctest_connect") == 0)
+            ++i;
+        else if (strncmp(argv[i], "--ctest_connect=", 16) != 0 &&
+                 ctest_write_all(fd, argv[i], strlen(argv[i]) + 1) != 0)
+            break;
+    }
+    shutdown(fd, SHUT_WR);
+
+    // copy the output, holding back what may be the trailer
+    char buf[4096 + CTEST_SERVE_TRAILER_LEN];
+    size_t len = 0;
+    ssize_t n;
+    while ((n = read(fd, buf + len, sizeof buf - len)) != 0) {
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            break;
+        len += n;
+        if (len > CTEST_SERVE_TRAILER_LEN) {
+            fwrite(buf, 1, len - CTEST_SERVE_TRAILER_LEN, stdout);
+            memmove(buf, buf + len - CTEST_SERVE_TRAILER_LEN, CTEST_SERVE_TRAILER_LEN);
+            len = CTEST_SERVE_TRAILER_LEN;
+        }
+    }
+    close(fd);
+
+    if (len == CTEST_SERVE_TRAILER_LEN &&
+        memcmp(buf, CTEST_SERVE_TRAILER, CTEST_SERVE_TRAILER_LEN - 1) == 0)
+        return (unsigned char)buf[CTEST_SERVE_TRAILER_LEN - 1];
+
+    fwrite(buf, 1, len, stdout);
+    fprintf(stderr, "ctest: connection to %s closed without exit status\n", path);
+    return EXIT_FAILURE;
+}
+
+#ifdef CTEST_RUNNER
+/**
+ * @brief Load test modules from a colon separated list of shared objects.
+ *
+ * Modules must be built with CTEST_SHARED_RUNTIME, their tests register
+ * in the registry of the runner while the module is opened.
+ */
+static int ctest_load_modules(const char * paths) {
+    for (const char * path = paths; *path; ) {
+        size_t len = strcspn(path, ":");
+        char * file = strndup(path, len);
+        if (!file)
+            return -1;
+
+        // module name is the file name without directories and extensions
+        const char * base = strrchr(file, '/');
+        ctest_module = base ? base + 1 : file;
+        ctest_module_len = strcspn(ctest_module, ".");
+
+        void * handle = dlopen(file, RTLD_NOW | RTLD_LOCAL);
+        ctest_module = 0;
+        if (!handle)
+            fprintf(stderr, "ctest: cannot load module: %s\n", dlerror());
+        free(file);
+        if (!handle)
+            return -1;
+
+        path += len;
+        if (*path == ':')
+            ++path;
+    }
+    return 0;
+}
+#endif
+
+int ctest_main(int * argc_p, char *argv[]) {
+    // ctest_get_config() removes ctest options from argv, keep a copy for the client
+    int argc = *argc_p;
+    char ** args = malloc((argc + 1) * sizeof *args);
+    if (args)
+        memcpy(args, argv, (argc + 1) * sizeof *args);
+
+    struct ctest_config cfg = ctest_get_config(argc_p, argv);
+#ifdef CTEST_RUNNER
+    int load_failed = cfg.load && !cfg.connect && ctest_load_modules(cfg.load) != 0;
+#else
+    int load_failed = 0;
+#endif
+    ctest_tail_p = 0; // freeze tests
+
+    int ret;
+    if (!cfg.is_correct || cfg.show_help || !args) {
+        ctest_show_help();
+        ret = EXIT_FAILURE;
+    } else if (load_failed) {
+        ret = EXIT_FAILURE;
+    } else if (cfg.connect) {
+        ret = ctest_connect(cfg.connect, argc, args);
+    } else if (cfg.serve) {
+        ret = ctest_serve(cfg, argv[0]);
+    } else {
+        ret = ctest_run_main(cfg);
+    }
+
+    free(args);
+    return ret;
+}
+
 #endif /* CTEST_IMPLEMENTATION */
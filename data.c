@@ -0,0 +1,48 @@
+/*
+ * Data driven tests over generated case files.
+ *
+ *   cc -o data data.c
+ *   ./data                                  # all 2000 cases of both tests
+ *   ./data --ctest_filter=Vec.Add/42        # a single case of Vec.Add
+ *   ./data --ctest_filter='Vec.Add/1*'      # cases 1, 10-19, 100-199
+ *   ./data --ctest_filter='*'/7             # case 7 of every data test
+ *
+ * Case files are written to the working directory before tests run.
+ */
+#define CTEST_IMPLEMENTATION
+#include "ctest.h"
+
+#include <stdio.h>
+
+#define CASES 1000
+
+struct add_case { int a, b, sum; };
+struct mul_case { int a, b, product; };
+
+__attribute__((constructor))
+static void write_cases(void) {
+	FILE * add = fopen("vec_add.bin", "wb");
+	FILE * mul = fopen("vec_mul.bin", "wb");
+	for (int i = 0; add && mul && i < CASES; ++i) {
+		struct add_case ac = { i, 2 * i, 3 * i };
+		struct mul_case mc = { i, 3, 3 * i };
+		fwrite(&ac, sizeof ac, 1, add);
+		fwrite(&mc, sizeof mc, 1, mul);
+	}
+	if (add)
+		fclose(add);
+	if (mul)
+		fclose(mul);
+}
+
+TEST_DATA(Vec, Add, "vec_add.bin", struct add_case) {
+	EXPECT_EQ(self->a, (int)case_index);
+	EXPECT_EQ(self->a + self->b, self->sum);
+}
+
+TEST_DATA(Vec, Mul, "vec_mul.bin", struct mul_case) {
+	EXPECT_EQ(self->a, (int)case_index);
+	EXPECT_EQ(self->a * self->b, self->product);
+}
+
+CTEST_MAIN()
@@ -0,0 +1,60 @@
+/*
+ * Tests selected by the functions they execute.
+ *
+ *   cc -DCTEST_IMPACT -finstrument-functions \
+ *      -finstrument-functions-exclude-file-list=ctest.h -o impact impact.c
+ *   ./impact --ctest_record_impact=impact.idx
+ *   echo checksum > changed.txt
+ *   ./impact --ctest_impact_index=impact.idx --ctest_impacted_by=changed.txt
+ *
+ * impact.idx then holds one line per test, e.g.
+ * "Impact.Checksum ImpactChecksum checksum", and only Impact.Checksum and
+ * Impact.RoundTrip run with checksum changed.
+ */
+#define CTEST_IMPLEMENTATION
+#include "ctest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+__attribute__((noinline))
+static int parse_int(const char * s) {
+	return (int)strtol(s, NULL, 10);
+}
+
+__attribute__((noinline))
+static void format_int(char * buf, size_t size, int value) {
+	snprintf(buf, size, "%d", value);
+}
+
+__attribute__((noinline))
+static unsigned checksum(const char * s) {
+	unsigned sum = 0;
+	while (*s)
+		sum = sum * 31 + (unsigned char)*s++;
+	return sum;
+}
+
+TEST(Impact, Parse) {
+	EXPECT_EQ(parse_int("42"), 42);
+	EXPECT_EQ(parse_int("-7"), -7);
+}
+
+TEST(Impact, Format) {
+	char buf[16];
+	format_int(buf, sizeof buf, 1234);
+	EXPECT_STR_EQ(buf, "1234");
+}
+
+TEST(Impact, Checksum) {
+	EXPECT_EQ(checksum(""), 0u);
+	EXPECT_NE(checksum("ab"), checksum("ba"));
+}
+
+TEST(Impact, RoundTrip) {
+	char buf[16];
+	format_int(buf, sizeof buf, parse_int("99"));
+	EXPECT_EQ(checksum(buf), checksum("99"));
+}
+
+CTEST_MAIN()
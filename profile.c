@@ -0,0 +1,42 @@
+/*
+ * Tests exercising the sampling profiler.
+ *
+ *   cc -fno-omit-frame-pointer -o profile profile.c
+ *   ./profile --ctest_profile=prof --ctest_profile_freq=1000
+ *
+ * prof/Profile.Split.folded then holds one line per distinct stack, e.g.
+ * "ctest_run;ctest_step;ProfileSplit;sum_cubes 62".
+ */
+#define CTEST_IMPLEMENTATION
+#include "ctest.h"
+
+static volatile unsigned sink;
+
+__attribute__((noinline))
+static unsigned sum_squares(unsigned n) {
+	unsigned sum = 0;
+	for (unsigned i = 0; i < n; ++i)
+		sink = sum += i * i;
+	return sum;
+}
+
+__attribute__((noinline))
+static unsigned sum_cubes(unsigned n) {
+	unsigned sum = 0;
+	for (unsigned i = 0; i < n; ++i)
+		sink = sum += i * i * i;
+	return sum;
+}
+
+TEST(Profile, Sum) {
+	EXPECT_EQ(sum_squares(100000000), sum_squares(100000000));
+}
+
+TEST(Profile, Split) {
+	for (int i = 0; i < 4; ++i) {
+		sum_squares(25000000);
+		sum_cubes(25000000);
+	}
+}
+
+CTEST_MAIN()
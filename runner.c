@@ -0,0 +1,12 @@
+/*
+ * Runner for test modules built with CTEST_SHARED_RUNTIME.
+ *
+ *   cc -rdynamic -o runner runner.c
+ *   cc -shared -fPIC -DCTEST_SHARED_RUNTIME -o fixture.so fixture.c
+ *   ./runner --ctest_load=fixture.so:testtest.so
+ */
+#define CTEST_RUNNER
+#define CTEST_IMPLEMENTATION
+#include "ctest.h"
+
+CTEST_MAIN()
@@ -82,4 +82,49 @@ TEST(Types, Basic) {
 
 }
 
+static int polls;
+
+TEST(Eventually, Basic) {
+	polls = 0;
+	EXPECT_EVENTUALLY(++polls >= 100, 1000);
+	ASSERT_EVENTUALLY(polls >= 100, 0);
+	EXPECT_EVENTUALLY(polls < 0, 20);
+	ASSERT_EVENTUALLY(polls < 0, 20) {
+		LOG("polled %d times\n", polls);
+	}
+	LOG("should never print\n");
+}
+
+static int counter;
+
+static void increment(void * arg) {
+	(void)arg;
+	int value = counter;
+	ctest_yield_point();
+	counter = value + 1;
+}
+
+TEST_SCHED(Sched, Race) {
+	counter = 0;
+	ctest_thread(increment, 0);
+	ctest_thread(increment, 0);
+	ctest_join();
+	ASSERT_EQ(counter, 2);
+}
+
+static int done;
+
+static void finish(void * arg) {
+	(void)arg;
+	ctest_yield_point();
+	done = 1;
+}
+
+TEST_SCHED(Sched, Eventually) {
+	done = 0;
+	ctest_thread(finish, 0);
+	EXPECT_EVENTUALLY(done, 5);
+	ctest_join();
+}
+
 CTEST_MAIN()